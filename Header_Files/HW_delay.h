@@ -8,9 +8,12 @@
 #ifndef SRC_HW_DELAY_H_
 #define SRC_HW_DELAY_H_
 
-#include "em_timer.h"
 #include "em_cmu.h"
+#include "brd_config.h"
 
-void timer_delay(uint32_t ms_delay);
+#define TIMER_DELAY_SLOTS   4   // Async delays that can be pending at once
+
+void timer_delay_open(void);
+void timer_delay_async(uint32_t ms_delay, uint32_t cb);
 
 #endif /* SRC_HW_DELAY_H_ */
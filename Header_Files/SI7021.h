@@ -15,24 +15,54 @@
 #include "em_assert.h"
 #include "em_i2c.h"
 #include "i2c.h"
-#include "HW_delay.h"
 #include "brd_config.h"
+#include "sensor.h"
 
 #define SI7021_STARTUP_TIME   80
 #define SI7021_DEVICE_ADDR    0x40
 #define SI7021_HUM_CMD        0xF5
 #define SI7021_TEMP_CMD       0xF3
+#define SI7021_TEMP_FROM_RH_CMD 0xE0  // Temperature of the last RH conversion, no checksum
+#define SI7021_CRC_INIT       0x00
+#define SI7021_MEASURE_BYTES  3     // MSB, LSB, checksum
+
+// Positions in the sensor's raw buffer
+#define SI7021_RAW_HUM        0
+#define SI7021_RAW_TEMP       3
+#define SI7021_RAW_USER       5
+
+// Code to centi-unit conversion: ((gain * code) >> 16) + offset
+#define SI7021_HUM_GAIN       12500u
+#define SI7021_HUM_OFFSET     (-600)
+#define SI7021_TEMP_GAIN      17572u
+#define SI7021_TEMP_OFFSET    (-4685)
 
 #define SI7021_READ_USER_CMD    0xE7
 #define SI7021_WRITE_USER_CMD   0xE6
 #define SI7021_USER_SETTINGS    0b00111011
 
-void si7021_i2c_open(uint32_t cb);
-void si7021_read_humidity(uint32_t cb);
-void si7021_read_temp(uint32_t cb);
-float si7021_get_humidity();
-float si7021_get_temp();
-uint32_t si7021_get_user_settings();
+// Measurement resolution, user register bits RES1 (7) and RES0 (0)
+#define SI7021_RES_MASK       0x81
+#define SI7021_RES_BITS(settings) ((((settings) >> 6) & 0x2) | ((settings) & 0x1))
+#define SI7021_RES_SETTINGS(res)  ((((res) & 0x2) << 6) | ((res) & 0x1))
+#define SI7021_RES_RH12_T14   0
+#define SI7021_RES_RH8_T12    1
+#define SI7021_RES_RH10_T13   2
+#define SI7021_RES_RH11_T11   3
+// ms for an RH conversion and its temperature conversion, datasheet maxima rounded up
+#define SI7021_CONVERSION_TIME(res) ((res) == SI7021_RES_RH12_T14 ? 23 :  /* 12 ms + 10.8 ms */ \
+                                     (res) == SI7021_RES_RH8_T12 ? 7 :    /* 3.1 ms + 3.8 ms */ \
+                                     (res) == SI7021_RES_RH10_T13 ? 11 :  /* 4.5 ms + 6.2 ms */ \
+                                     10)                                  /* 7 ms + 2.4 ms */
+
+void si7021_i2c_open(uint32_t step_cb);
+void si7021_configure(uint32_t cb);
+void si7021_set_timed_conversion(bool timed);
+void si7021_set_resolution(uint32_t res);
+void si7021_read_hum_and_temp(uint32_t cb);
+void si7021_step(void);
+bool si7021_get_reading(const SCHEDULER_MESSAGE_STRUCT *message, SENSOR_READING_STRUCT *reading);
+uint32_t si7021_get_user_settings(const SCHEDULER_MESSAGE_STRUCT *message);
 
 
 #endif /* SRC_HEADER_FILES_SI7021_H_ */
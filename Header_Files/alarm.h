@@ -0,0 +1,69 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef ALARM_HG
+#define ALARM_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Default thresholds, centi-%RH and centi-C
+#define ALARM_HUMIDITY_HIGH_LEVEL   3000
+#define ALARM_HUMIDITY_HIGH_BAND    100
+#define ALARM_CONDENSATION_LEVEL    8000
+#define ALARM_CONDENSATION_BAND     300
+#define ALARM_TEMP_HIGH_LEVEL       3500
+#define ALARM_TEMP_HIGH_BAND        100
+#define ALARM_TEMP_LOW_LEVEL        500
+#define ALARM_TEMP_LOW_BAND         100
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  ALARM_HUMIDITY_HIGH,
+  ALARM_CONDENSATION,
+  ALARM_TEMP_HIGH,
+  ALARM_TEMP_LOW,
+  ALARM_COUNT,
+} ALARM_ID_TypeDef;
+
+typedef enum {
+  ALARM_CHANNEL_HUMIDITY,
+  ALARM_CHANNEL_TEMP,
+} ALARM_CHANNEL_TypeDef;
+
+typedef struct {
+  ALARM_CHANNEL_TypeDef channel;
+  bool above; // true: raised at or above the level, false: at or below it
+  int32_t level; // Value the alarm is raised at
+  int32_t band; // Distance back past the level before the alarm clears
+} ALARM_STRUCT;
+
+typedef struct {
+  uint8_t id; // ALARM_ID_TypeDef of the alarm that changed
+  bool active; // true when raised, false when cleared
+  int32_t value; // Value that caused the transition
+} ALARM_EVENT_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void alarm_open(uint32_t alarm_cb);
+void alarm_configure(ALARM_ID_TypeDef id, int32_t level, int32_t band);
+void alarm_update(int32_t humidity, int32_t temp, uint32_t timestamp);
+bool alarm_receive(ALARM_EVENT_STRUCT *event, uint32_t *timestamp);
+bool alarm_active(ALARM_ID_TypeDef id);
+
+#endif
@@ -19,14 +19,20 @@
 #include "SI7021.h"
 #include "shtc3.h"
 #include "scheduler.h"
-
-#include <stdio.h>
+#include "sample_buffer.h"
+#include "flash_log.h"
+#include "telemetry.h"
+#include "alarm.h"
+#include "cadence.h"
+#include "sensor_power.h"
+#include "profile.h"
+#include "fusion.h"
 
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
-#define   PWM_PER       3   // PWM period in seconds
+#define   PWM_PER       3   // PWM period in seconds, fastest sample cadence
 #define   PWM_ACT_PER     0.25  // PWM active period in seconds
 //#define   PWM_ROUTE_0    28
 //#define   PWM_ROUTE_1    0
@@ -36,12 +42,28 @@
 #define LETIMER0_UF_CB      0x004
 #define GPIO_EVEN_IRQ_CB    0x008
 #define GPIO_ODD_IRQ_CB     0x010
-#define SI7021_READ_HUM_CB  0x020
-#define SI7021_READ_TEMP_CB 0x040
+#define SI7021_READ_CB      0x020
+#define SENSOR_POWER_CB     0x040
 #define SHTC3_READ_CB       0x080
 #define SI7021_USER_CONFIRM 0x100
-
-#define HUMIDITY_COMPARE  30.0
+#define SHTC3_STEP_CB       0x200
+#define SAMPLE_BATCH_CB     0x400
+#define SENSORS_READY_CB    0x800
+#define SAMPLE_DONE_CB      0x1000
+#define I2C_TIMEOUT_CB      0x2000
+#define SI7021_STEP_CB      0x4000
+#define ALARM_CB            0x8000
+#define SENSORS_BOOT_CB     0x10000
+
+// Sample buffer channels
+#define SAMPLE_CH_SI7021_HUM  0
+#define SAMPLE_CH_SI7021_TEMP 1
+#define SAMPLE_CH_SHTC3_TEMP  2
+#define SAMPLE_CH_SHTC3_HUM   3
+#define SAMPLE_BATCH_SIZE     40  // Records per batch, 10 LETIMER cycles
+#define TELEMETRY_ESTIMATE_RESERVE 2 // Frames kept free for estimates when blocks are sent
+
+#define HUMIDITY_COMPARE  ALARM_HUMIDITY_HIGH_LEVEL  // centi-%RH, the cadence speeds up near it
 
 
 //***********************************************************************************
@@ -61,11 +83,20 @@ void scheduled_letimer0_comp1_cb (void);
 void scheduled_gpio_odd_irq_cb (void);
 void scheduled_gpio_even_irq_cb (void);
 
-void scheduled_si7021_read_hum_cb(void);
-void scheduled_si7021_read_temp_cb(void);
+void scheduled_si7021_read_cb(void);
+void scheduled_sensor_power_cb(void);
+void scheduled_sensors_ready_cb(void);
+void scheduled_sensors_boot_cb(void);
+void scheduled_sample_done_cb(void);
+void scheduled_i2c_timeout_cb(void);
+void scheduled_alarm_cb(void);
 
 void scheduled_shtc3_read_irq_cb(void);
+void scheduled_shtc3_step_cb(void);
+void scheduled_si7021_step_cb(void);
 
 void scheduled_si7021_user_confirm(void);
 
+void scheduled_sample_batch_cb(void);
+
 #endif
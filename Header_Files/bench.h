@@ -0,0 +1,66 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef BENCH_HG
+#define BENCH_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_core.h"
+#include "em_cmu.h"
+#include "em_timer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+//#define SAMPLE_BENCH    // Define here or in the build to measure the cost of every sample
+
+#ifdef SAMPLE_BENCH
+#define BENCH_TIMER     WTIMER1 // 32-bit and HFPER clocked, so it only counts in EM0 and EM1
+#define BENCH_CLOCK     cmuClock_WTIMER1
+#define BENCH_PRESCALE  timerPrescale16
+#define BENCH_DIVISOR   16u
+
+#define BENCH_ISR()                 bench_isr()
+#define BENCH_BUS(which_i2c, busy)  bench_bus((which_i2c), (busy))
+#define BENCH_CYCLE()               bench_cycle()
+#else
+#define BENCH_ISR()
+#define BENCH_BUS(which_i2c, busy)
+#define BENCH_CYCLE()
+#endif
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+#ifdef SAMPLE_BENCH
+typedef struct {
+  uint32_t isr_count; // Interrupts taken
+  uint32_t awake_us; // Time the HF clocks ran, in EM0 or EM1
+  uint32_t bus_busy_us[2]; // Time each I2C bus had transfers queued
+} BENCH_CYCLE_STRUCT;
+
+typedef struct {
+  uint32_t cycles; // Sample cycles measured
+  BENCH_CYCLE_STRUCT last; // Cost of the last sample cycle
+  BENCH_CYCLE_STRUCT worst; // Largest cost of any sample cycle, per field
+} BENCH_STRUCT;
+#endif
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+#ifdef SAMPLE_BENCH
+void bench_open(void);
+void bench_isr(void);
+void bench_bus(bool which_i2c, bool busy);
+void bench_cycle(void);
+void bench_get(BENCH_STRUCT *bench);
+void bench_reset(void);
+#endif
+
+#endif
@@ -93,9 +93,28 @@
 //#define I2C1_SDA_ROUTE I2C_ROUTELOC0_SDALOC_LOC19
 //#define I2C1_SCL_ROUTE I2C_ROUTELOC0_SCLLOC_LOC19
 
+// LEUART0 telemetry TX pin is
+#define LEUART0_TX_PORT       gpioPortD
+#define LEUART0_TX_PIN        10u
+#define LEUART0_TX_CONFIG     gpioModePushPull
+#define LEUART0_TX_DEFAULT    true  // Line idles high
+#define LEUART0_TX_ROUTE      LEUART_ROUTELOC0_TXLOC_LOC18
+
 #define I2C1_SDA_ROUTE I2C_ROUTELOC0_SDALOC_LOC6
 #define I2C1_SCL_ROUTE I2C_ROUTELOC0_SCLLOC_LOC6
 
+// I2C bus selection, which is false (0) = I2C0, true (1) = I2C1. With a
+// constant which, as the sensors' WHICH_I2C are, these fold at compile time.
+#define I2C_NUM_BUSES           2
+#define I2C_BUS(which)          ((which) ? I2C1 : I2C0)
+#define I2C_BUS_WHICH(i2cx)     ((i2cx) == I2C1)
+#define I2C_BUS_CLOCK(which)    ((which) ? cmuClock_I2C1 : cmuClock_I2C0)
+#define I2C_BUS_IRQN(which)     ((which) ? I2C1_IRQn : I2C0_IRQn)
+#define I2C_BUS_SDA_ROUTE(which) ((which) ? I2C1_SDA_ROUTE : I2C0_SDA_ROUTE)
+#define I2C_BUS_SCL_ROUTE(which) ((which) ? I2C1_SCL_ROUTE : I2C0_SCL_ROUTE)
+#define I2C_BUS_SCL_PORT(which) ((which) ? SHTC3_SCL_PORT : SI7021_SCL_PORT)
+#define I2C_BUS_SCL_PIN(which)  ((which) ? SHTC3_SCL_PIN : SI7021_SCL_PIN)
+
 //***********************************************************************************
 // global variables
 //***********************************************************************************
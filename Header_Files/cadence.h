@@ -0,0 +1,39 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef CADENCE_HG
+#define CADENCE_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "letimer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define CADENCE_SLOW_MS         60000 // Sample period while readings are stable
+#define CADENCE_SETTLE_MS       30000 // Time inside the dead-band before slowing down
+#define CADENCE_HUM_DEADBAND    50    // centi-%RH drift that still counts as stable
+#define CADENCE_TEMP_DEADBAND   20    // centi-C drift that still counts as stable
+#define CADENCE_WATCH_BAND      200   // centi-%RH around the watched humidity sampled fast
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void cadence_open(uint32_t fast_ms, int32_t watch_humidity);
+void cadence_update(int32_t humidity, int32_t temp);
+void cadence_set_fast_period(uint32_t fast_ms);
+uint32_t cadence_get_period(void);
+
+#endif
@@ -12,6 +12,7 @@
 #include "em_assert.h"
 
 /* The developer's include statements */
+#include "brd_config.h"
 
 
 
@@ -0,0 +1,31 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef CRC8_HG
+#define CRC8_HG
+
+/* System include statements */
+#include <stdint.h>
+
+/* Silicon Labs include statements */
+
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define CRC8_POLYNOMIAL   0x31    // x^8 + x^5 + x^4 + 1, used by the SHTC3 and SI7021
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+uint8_t crc8(const uint8_t *data, uint32_t len, uint8_t init);
+
+#endif
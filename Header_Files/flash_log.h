@@ -0,0 +1,48 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef FLASH_LOG_HG
+#define FLASH_LOG_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_msc.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "sample_buffer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FLASH_LOG_PAGES         32  // 64 kB at the top of flash, rotated for wear levelling
+#define FLASH_LOG_BASE          (FLASH_BASE + FLASH_SIZE - FLASH_LOG_PAGES * FLASH_PAGE_SIZE)
+#define FLASH_LOG_MAGIC         0x4C4F4731u // "LOG1"
+#define FLASH_LOG_HEADER_BYTES  8u
+#define FLASH_LOG_PAGE_BLOCKS   ((FLASH_PAGE_SIZE - FLASH_LOG_HEADER_BYTES) / sizeof(SAMPLE_BLOCK))
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// Layout of a written log page. The header is written last, so a page whose
+// magic matches holds FLASH_LOG_PAGE_BLOCKS complete blocks.
+typedef struct {
+  uint32_t magic; // FLASH_LOG_MAGIC on written pages, erased otherwise
+  uint32_t sequence; // Counts up on every page written, the highest is the head
+  SAMPLE_BLOCK blocks[FLASH_LOG_PAGE_BLOCKS];
+} FLASH_LOG_PAGE_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void flash_log_open(void);
+void flash_log_append(const SAMPLE_BLOCK *block);
+uint32_t flash_log_count(void);
+bool flash_log_read(uint32_t index, SAMPLE_BLOCK *block);
+
+#endif
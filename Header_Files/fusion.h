@@ -0,0 +1,66 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef FUSION_HG
+#define FUSION_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "sensor.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Calibration offsets added to each sensor's readings
+#define FUSION_SI7021_HUM_OFFSET    0   // centi-%RH
+#define FUSION_SI7021_TEMP_OFFSET   0   // centi-C
+#define FUSION_SHTC3_HUM_OFFSET     0   // centi-%RH
+#define FUSION_SHTC3_TEMP_OFFSET    0   // centi-C
+
+// SHTC3 weight out of FUSION_WEIGHT_SCALE, from the inverse squares of the
+// datasheet accuracies: RH 2 % vs 3 %, T 0.2 C vs 0.4 C
+#define FUSION_WEIGHT_SCALE         16
+#define FUSION_SHTC3_HUM_WEIGHT     11
+#define FUSION_SHTC3_TEMP_WEIGHT    13
+
+// Largest disagreement that is still within both sensors' accuracy
+#define FUSION_HUM_TOLERANCE        500 // centi-%RH
+#define FUSION_TEMP_TOLERANCE       60  // centi-C
+
+#define FUSION_AGREE_SAMPLES        10  // Agreeing samples before only the SHTC3 is read
+#define FUSION_CROSSCHECK_SAMPLES   20  // Single sensor samples between cross-checks
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  FUSION_SI7021,
+  FUSION_SHTC3,
+  FUSION_NUM_SENSORS,
+} FUSION_SENSOR_TypeDef;
+
+typedef struct {
+  int32_t humidity; // centi-%RH
+  int32_t temp; // centi-C
+  uint32_t timestamp; // LETIMER tick of the newest reading used
+  uint32_t sources; // Bit per FUSION_SENSOR_TypeDef used for this estimate
+  bool drift; // The sensors disagreed beyond their tolerance
+} FUSION_ESTIMATE_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void fusion_open(void);
+void fusion_begin(uint32_t now);
+void fusion_add(FUSION_SENSOR_TypeDef sensor, const SENSOR_READING_STRUCT *reading, uint32_t timestamp);
+bool fusion_update(FUSION_ESTIMATE_STRUCT *estimate);
+bool fusion_wants(FUSION_SENSOR_TypeDef sensor);
+uint32_t fusion_drift_count(void);
+
+#endif
@@ -15,6 +15,7 @@
 /* The developer's include statements */
 #include "brd_config.h"
 #include "scheduler.h"
+#include "bench.h"
 
 //***********************************************************************************
 // defined files
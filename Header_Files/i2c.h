@@ -14,18 +14,51 @@
 #include "em_cmu.h"
 #include "em_assert.h"
 #include "em_i2c.h"
+#include "brd_config.h"
 #include "sleep_routines.h"
 #include "scheduler.h"
+#include "ldma.h"
+#include "swtimer.h"
+#include "bench.h"
 
 #define I2C_EM  EM2
+#define I2C_SLEEP_CALLER(which) ((which) ? SLEEP_CALLER_I2C1 : SLEEP_CALLER_I2C0)
 #define I2C_R 1u
 #define I2C_W 0u
+#define I2C_QUEUE_SIZE 8 // Pending transfers per bus
+#define I2C_LDMA_MIN_BYTES 4 // Read bytes moved by LDMA from this transfer length on
+#define I2C0_LDMA_CH 0
+#define I2C1_LDMA_CH 1
+#define I2C_BUS_LDMA_CH(which) ((which) ? I2C1_LDMA_CH : I2C0_LDMA_CH)
+#define I2C_BUS_LDMA_RX(which) ((which) ? ldmaPeripheralSignal_I2C1_RXDATAV : ldmaPeripheralSignal_I2C0_RXDATAV)
+#define I2C_NACK_RETRIES 2000 // Read header NACKs while a slave converts, ~60 ms in fast mode
+#define I2C_TRANSFER_RETRIES 2 // Bus resets and restarts before a transfer fails
+#define I2C_TIMEOUT_MS 100 // A transfer still on the bus after 1 to 2 checks is stuck
+#define I2C_RESET_POLLS 10000 // MSTOP polls before a bus reset gives up, far past a stop time
+#define I2C_CLOCKOUT_PULSES 9 // SCL pulses that free a slave stuck inside a byte
+#define I2C_CLOCKOUT_LOOPS 50 // Busy loops per SCL half period, slower than 100 kHz
 
 typedef enum {
   I2C_READ,
   I2C_WRITE,
 } I2C_COMM_METHOD_TypeDef;
 
+typedef enum {
+  I2C_STATUS_OK,
+  I2C_STATUS_NACK, // Slave NACKed past the retries
+  I2C_STATUS_TIMEOUT, // Transfer stalled on the bus
+  I2C_STATUS_BUS_ERROR, // Bus error, lost arbitration or unexpected interrupt
+} I2C_STATUS_TypeDef;
+
+typedef struct {
+  uint32_t nacks; // Unexpected NACKs and read polls that ran out
+  uint32_t timeouts; // Transfers found stalled by the timeout check
+  uint32_t bus_errors; // Bus errors, lost arbitration and unexpected interrupts
+  uint32_t resets; // Bus resets done to recover
+  uint32_t failed_resets; // Bus resets that saw no stop and clocked SCL by hand
+  uint32_t failures; // Transfers given up after I2C_TRANSFER_RETRIES
+} I2C_ERROR_STRUCT;
+
 typedef struct {
   bool enable;
   bool master;
@@ -38,19 +71,27 @@ typedef struct {
 
 } I2C_OPEN_STRUCT;
 
-typedef struct {
+typedef struct I2C_START_STRUCT I2C_START_STRUCT;
+
+struct I2C_START_STRUCT {
   bool which_i2c;
   I2C_COMM_METHOD_TypeDef comm_method;
   uint32_t device_address;
   uint32_t register_address;
   uint32_t num_bytes;
   uint32_t finished_callback;
-  uint32_t* data;
+  uint8_t* data; // Caller-owned buffer of num_bytes, written MSB first
   uint32_t num_register_bytes;
-} I2C_START_STRUCT;
+  I2C_START_STRUCT* next; // Caller-owned transfer run right after this one, or NULL
+  I2C_STATUS_TypeDef* status; // Result written when the transfer finishes, or NULL
+};
 
 void i2c_open(I2C_TypeDef *i2cx, I2C_OPEN_STRUCT *i2c_setup);
 void i2c_start(I2C_START_STRUCT *i2c_start);
+void i2c_reset(I2C_TypeDef *i2cx);
+void i2c_timeout_open(uint32_t timeout_cb);
+void i2c_timeout_check(void);
+void i2c_get_errors(I2C_TypeDef *i2cx, I2C_ERROR_STRUCT *errors);
 // void i2c_isr(I2C_TypeDef *i2cx);
 
 void I2C0_IRQHandler();
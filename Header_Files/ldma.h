@@ -0,0 +1,41 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef LDMA_HG
+#define LDMA_HG
+
+/* System include statements */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_ldma.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "bench.h"
+
+/* The developer's include statements */
+
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LDMA_NUM_CHANNELS   8   // Channels available on the EFM32PG12
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef void (*LDMA_DONE_HANDLER)(uint32_t channel);
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void ldma_open(void);
+void ldma_start(uint32_t channel, const LDMA_TransferCfg_t *cfg, const LDMA_Descriptor_t *desc, LDMA_DONE_HANDLER done);
+void ldma_stop(uint32_t channel);
+
+void LDMA_IRQHandler(void);
+
+#endif
@@ -13,12 +13,15 @@
 /* The developer's include statements */
 #include "sleep_routines.h"
 #include "scheduler.h"
+#include "bench.h"
 
 //***********************************************************************************
 // defined files
 //***********************************************************************************
 #define LETIMER_HZ		1000			// Utilizing ULFRCO oscillator for LETIMERs
 #define LETIMER_EM    EM4       // Using the ULFRCO, block from entering Energy Mode 4
+#define LETIMER_COMP_MARGIN 3   // Ticks for a COMP1 write to reach the LF domain
+#define LETIMER_MAX_TOP     0xFFFF  // 16-bit counter
 
 //***********************************************************************************
 // global variables
@@ -28,8 +31,8 @@ typedef struct {
 	bool 			enable;				// enable the LETIMER upon completion of open
 	uint32_t		out_pin_route0;		// out 0 route to gpio port/pin
 	uint32_t		out_pin_route1;		// out 1 route to gpio port/pin
-	bool			out_pin_0_en;		// enable out 0 route
-	bool			out_pin_1_en;		// enable out 1 route
+	bool			out_pin_0_en;		// enable out 0 route, must be false while software timers use COMP1
+	bool			out_pin_1_en;		// enable out 1 route, must be false as well
 	float			period;				// seconds
 	float			active_period;		// seconds
 
@@ -49,6 +52,10 @@ typedef struct {
 //***********************************************************************************
 void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_letimer_struct);
 void letimer_start(LETIMER_TypeDef *letimer, bool enable);
+void letimer_set_period(LETIMER_TypeDef *letimer, uint32_t period_ms);
+uint32_t letimer_get_ticks(LETIMER_TypeDef *letimer);
+void letimer_comp1_deadline(LETIMER_TypeDef *letimer, uint32_t deadline);
+void letimer_comp1_cancel(LETIMER_TypeDef *letimer);
 void LETIMER0_IRQHandler(void);
 
 #endif
@@ -0,0 +1,49 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef LEUART_HG
+#define LEUART_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_cmu.h"
+#include "em_leuart.h"
+#include "em_assert.h"
+#include "em_core.h"
+
+/* The developer's include statements */
+#include "brd_config.h"
+#include "sleep_routines.h"
+#include "ldma.h"
+#include "bench.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LEUART_TX_EM      EM3 // The LEUART and its DMA wake-up run down to EM2
+#define LEUART0_LDMA_CH   2   // Channels 0 and 1 belong to the I2C buses
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef void (*LEUART_DONE_HANDLER)(void);
+
+typedef struct {
+  uint32_t baudrate;
+  uint32_t tx_route; // TX route location
+  bool tx_enable;
+} LEUART_OPEN_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_setup);
+void leuart_send(const uint8_t *data, uint32_t bytes, LEUART_DONE_HANDLER done);
+bool leuart_busy(void);
+
+void LEUART0_IRQHandler(void);
+
+#endif
@@ -0,0 +1,48 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef PROFILE_HG
+#define PROFILE_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "SI7021.h"
+#include "shtc3.h"
+#include "cadence.h"
+#include "sample_buffer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define PROFILE_COUNT     3
+#define PROFILE_DEFAULT   1   // Index of the profile used from boot
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+  const char *name;
+  uint32_t period_ms; // Fast sample period, the cadence slows down from it
+  uint32_t si7021_res; // One of the SI7021_RES_ values
+  SHTC3_POWER_TypeDef shtc3_power;
+  uint32_t batch_size; // Records per sample batch
+  bool si7021_active;
+  bool shtc3_active;
+} PROFILE_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void profile_open(void);
+void profile_next(void);
+void profile_previous(void);
+bool profile_apply_pending(void);
+const PROFILE_STRUCT *profile_get(void);
+
+#endif
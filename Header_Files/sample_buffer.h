@@ -0,0 +1,53 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SAMPLE_BUFFER_HG
+#define SAMPLE_BUFFER_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SAMPLE_BLOCK_DATA_BYTES   58    // Encoded record bytes per block (64 byte blocks)
+#define SAMPLE_NUM_BLOCKS         256   // 16 kB of SRAM
+#define SAMPLE_MAX_CHANNELS       4     // Channel id is stored in 2 bits
+#define SAMPLE_MAX_RECORD_BYTES   8     // 5 byte time varint + 3 byte code varint
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+  uint32_t  base_time;                        // Timestamp that the first record is relative to
+  uint8_t   num_records;                      // Records encoded in data
+  uint8_t   num_bytes;                        // Bytes of data used
+  uint8_t   data[SAMPLE_BLOCK_DATA_BYTES];    // Delta/varint encoded records
+} SAMPLE_BLOCK;
+
+typedef struct {
+  uint32_t  time;       // Timestamp of the reading
+  uint32_t  channel;    // Channel the reading belongs to
+  uint16_t  code;       // Raw 16-bit sensor code
+} SAMPLE_RECORD;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sample_buffer_open(uint32_t batch_size, uint32_t batch_cb);
+void sample_buffer_set_batch_size(uint32_t batch_size);
+void sample_buffer_add(uint32_t channel, uint16_t code, uint32_t time);
+uint32_t sample_buffer_count(void);
+uint32_t sample_buffer_dropped(void);
+uint32_t sample_buffer_drain(SAMPLE_BLOCK *blocks, uint32_t max_blocks);
+uint32_t sample_block_decode(const SAMPLE_BLOCK *block, SAMPLE_RECORD *records, uint32_t max_records);
+
+#endif
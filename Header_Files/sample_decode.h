@@ -0,0 +1,35 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SAMPLE_DECODE_HG
+#define SAMPLE_DECODE_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "sample_buffer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SAMPLE_DECODE_BLOCK_RECORDS (SAMPLE_BLOCK_DATA_BYTES / 2) // A record takes 2 bytes or more
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct {
+  uint32_t gain; // centi = ((gain * code) >> 16) + offset
+  int32_t offset;
+} SAMPLE_DECODE_SCALE_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sample_decode_convert(const uint16_t *restrict codes, int32_t *restrict centi, uint32_t count, const SAMPLE_DECODE_SCALE_STRUCT *scale);
+
+#endif
@@ -4,6 +4,7 @@
 
 /* System include statements */
 #include <stdint.h>
+#include <stdbool.h>
 
 /* Silicon Labs include statements */
 #include "em_assert.h"
@@ -13,14 +14,59 @@
 
 
 // defined files
+#define SCHEDULER_MAX_EVENTS      32  // One event per bit of the event mask
+
+#define SCHEDULER_PRIORITY_HIGH   0   // Dispatched first
+#define SCHEDULER_PRIORITY_MEDIUM 1
+#define SCHEDULER_PRIORITY_LOW    2
+#define SCHEDULER_NUM_PRIORITIES  3
+#define SCHEDULER_MAX_BARRIERS    2   // Barriers that can be armed at once
+#define SCHEDULER_QUEUE_SIZE      8   // Messages that can be pending at once
+#define SCHEDULER_PAYLOAD_BYTES   8   // Payload carried by each message
+
+//#define SCHEDULER_TRACE         // Define here or in the build to trace dispatch timing
+//#define SCHEDULER_TRACE_ITM     // Also stream every dispatch over SWO
+#define SCHEDULER_TRACE_ITM_PORT  1   // ITM stimulus port of the dispatch records
 
 // global variables
+typedef void (*SCHEDULER_HANDLER)(void);
+
+typedef struct {
+  uint32_t event; // Event the message was posted with
+  uint32_t status; // Set by the poster
+  uint32_t timestamp; // Set by the poster, such as letimer_get_ticks()
+  uint8_t payload[SCHEDULER_PAYLOAD_BYTES];
+} SCHEDULER_MESSAGE_STRUCT;
+
+#ifdef SCHEDULER_TRACE
+typedef struct {
+  uint32_t count; // Dispatches traced
+  uint32_t latency_min; // Core cycles from first post to handler start
+  uint32_t latency_max;
+  uint64_t latency_sum; // Mean is latency_sum / count
+  uint32_t run_min; // Core cycles the handler ran
+  uint32_t run_max;
+  uint64_t run_sum; // Mean is run_sum / count
+} SCHEDULER_TRACE_STRUCT;
+#endif
 
 // function prototypes
 
 void scheduler_open(void);
+void scheduler_register(uint32_t event, uint32_t priority, SCHEDULER_HANDLER handler);
+void scheduler_dispatch(void);
+void scheduler_barrier(uint32_t members, uint32_t join_event);
+bool scheduler_post(uint32_t event, const void *payload, uint32_t bytes, uint32_t status, uint32_t timestamp);
+bool scheduler_receive(uint32_t event, SCHEDULER_MESSAGE_STRUCT *message);
+uint32_t scheduler_messages_dropped(void);
 void add_scheduled_event(uint32_t event);
 void remove_scheduled_event(uint32_t event);
+uint32_t fetch_and_clear_events(void);
 uint32_t get_scheduled_events(void);
+
+#ifdef SCHEDULER_TRACE
+void scheduler_trace_get(uint32_t event, SCHEDULER_TRACE_STRUCT *trace);
+void scheduler_trace_reset(void);
+#endif
 #endif
 
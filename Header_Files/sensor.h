@@ -0,0 +1,107 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SENSOR_HG
+#define SENSOR_HG
+
+/* System include statements */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_i2c.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "brd_config.h"
+#include "i2c.h"
+#include "HW_delay.h"
+#include "letimer.h"
+#include "crc8.h"
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SENSOR_MAX_TRANSFERS  8   // I2C steps a sequence may chain back to back
+#define SENSOR_RAW_BYTES      8   // Bytes a sequence may read, sent as the done message payload
+
+#if SENSOR_RAW_BYTES > SCHEDULER_PAYLOAD_BYTES
+#error "A sequence's raw bytes must fit in a scheduler message"
+#endif
+
+// Sequence table entries
+#define SENSOR_WRITE(cmd, cmd_bytes, buf, bytes) \
+  { .type = SENSOR_STEP_WRITE, .command = (cmd), .num_command_bytes = (cmd_bytes), .data = (buf), .num_bytes = (bytes) }
+#define SENSOR_READ(cmd, cmd_bytes, bytes, raw_offset, has_crc) \
+  { .type = SENSOR_STEP_READ, .command = (cmd), .num_command_bytes = (cmd_bytes), .num_bytes = (bytes), .offset = (raw_offset), .crc = (has_crc) }
+#define SENSOR_DELAY(ms) \
+  { .type = SENSOR_STEP_DELAY, .delay = (ms) }
+#define SENSOR_END \
+  { .type = SENSOR_STEP_END }
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  SENSOR_STEP_END,
+  SENSOR_STEP_WRITE,
+  SENSOR_STEP_READ,
+  SENSOR_STEP_DELAY,
+} SENSOR_STEP_TypeDef;
+
+typedef struct {
+  SENSOR_STEP_TypeDef type;
+  uint32_t command; // Command bytes sent first, most significant byte first
+  uint32_t num_command_bytes; // 0 for a read that only sends the read header
+  uint8_t *data; // WRITE: bytes sent after the command
+  uint32_t num_bytes; // WRITE: bytes of data, READ: bytes read
+  uint32_t offset; // READ: position of the bytes in the raw buffer
+  bool crc; // READ: every 2 bytes are followed by their CRC-8
+  uint32_t delay; // DELAY: ms, delays the LETIMER cannot time are skipped
+} SENSOR_STEP_STRUCT;
+
+typedef enum {
+  SENSOR_STATUS_OK,
+  SENSOR_STATUS_BUS_ERROR, // An I2C transfer failed
+  SENSOR_STATUS_CRC_ERROR, // A checksum did not match its data
+} SENSOR_STATUS_TypeDef;
+
+typedef struct {
+  int32_t humidity; // centi-%RH
+  int32_t temp; // centi-C
+  uint16_t humidity_raw; // Code as read from the sensor
+  uint16_t temp_raw; // Code as read from the sensor
+} SENSOR_READING_STRUCT;
+
+typedef struct {
+  bool which_i2c; // false = I2C0, true = I2C1
+  uint32_t device_address;
+  uint32_t startup_time; // ms from power-up until the sensor answers
+  uint8_t crc_init; // CRC-8 initial value of the checksummed reads
+  void (*decode)(const uint8_t *raw, SENSOR_READING_STRUCT *reading);
+} SENSOR_DESCRIPTOR_STRUCT;
+
+typedef struct {
+  const SENSOR_DESCRIPTOR_STRUCT *desc;
+  const SENSOR_STEP_STRUCT *sequence; // Sequence run last
+  const SENSOR_STEP_STRUCT *step; // Next step to run
+  uint32_t step_cb; // Event to continue the sequence after a step
+  uint32_t done_cb; // Event posted with the raw bytes once the sequence is done
+  bool busy;
+  I2C_STATUS_TypeDef status; // Result of the sequence's I2C transfers
+  uint8_t raw[SENSOR_RAW_BYTES]; // Bytes read by the sequence
+  I2C_START_STRUCT transfers[SENSOR_MAX_TRANSFERS]; // Chained I2C steps
+} SENSOR_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sensor_open(SENSOR_STRUCT *sensor, const SENSOR_DESCRIPTOR_STRUCT *desc, uint32_t step_cb);
+void sensor_run(SENSOR_STRUCT *sensor, const SENSOR_STEP_STRUCT *sequence, uint32_t done_cb);
+void sensor_step(SENSOR_STRUCT *sensor);
+uint32_t sensor_startup_time(void);
+bool sensor_get_reading(const SENSOR_STRUCT *sensor, const SCHEDULER_MESSAGE_STRUCT *message, SENSOR_READING_STRUCT *reading);
+
+#endif
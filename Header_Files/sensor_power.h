@@ -0,0 +1,41 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SENSOR_POWER_HG
+#define SENSOR_POWER_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_gpio.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "brd_config.h"
+#include "i2c.h"
+#include "HW_delay.h"
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SENSOR_POWER_UP_TIME  80  // ms, SI7021 power-up time at full temperature range
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void sensor_power_open(uint32_t step_cb);
+void sensor_power_boot(uint32_t ready_cb, uint32_t startup_ms);
+void sensor_power_acquire(uint32_t ready_cb);
+void sensor_power_release(void);
+void sensor_power_step(void);
+bool sensor_power_is_on(void);
+
+#endif
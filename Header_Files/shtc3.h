@@ -15,18 +15,40 @@
 #include "em_assert.h"
 #include "em_i2c.h"
 #include "i2c.h"
-#include "HW_delay.h"
 #include "brd_config.h"
+#include "sensor.h"
 
 #define SHTC3_STARTUP_TIME 240
+#define SHTC3_WAKEUP_TIME 2 // ms, datasheet maximum is 240 us
 #define SHTC3_DEVICE_ADDRESS 0x70
 #define SHTC3_WAKEUP_CMD 0x3517
 #define SHTC3_SLEEP_CMD 0xB098
-#define SHTC3_MEASURE_CMD_T_FIRST 0x7866
-//#define SHTC3_MEASURE_CMD_T_FIRST 0x58E0
+#define SHTC3_CRC_INIT 0xFF
+#define SHTC3_MEASURE_BYTES 6 // T MSB, T LSB, T CRC, RH MSB, RH LSB, RH CRC
 
-void shtc3_i2c_open();
-void shtc3_app_get_temp_and_hum(float* temp, float* hum);
+// Code to centi-unit conversion: ((gain * code) >> 16) + offset
+#define SHTC3_HUM_GAIN 10000u
+#define SHTC3_HUM_OFFSET 0
+#define SHTC3_TEMP_GAIN 17500u
+#define SHTC3_TEMP_OFFSET (-4500)
+
+// Temperature first measure commands
+#define SHTC3_MEASURE_NORMAL 0x7866
+#define SHTC3_MEASURE_NORMAL_STRETCH 0x7CA2
+#define SHTC3_MEASURE_LP 0x609C
+#define SHTC3_MEASURE_LP_STRETCH 0x6458
+#define SHTC3_NORMAL_MEASURE_TIME 13 // ms, datasheet maximum is 12.1 ms
+#define SHTC3_LP_MEASURE_TIME 1 // ms, datasheet maximum is 0.8 ms
+
+typedef enum {
+  SHTC3_POWER_NORMAL,
+  SHTC3_POWER_LOW,
+} SHTC3_POWER_TypeDef;
+
+void shtc3_i2c_open(uint32_t step_cb);
+bool shtc3_get_reading(const SCHEDULER_MESSAGE_STRUCT *message, SENSOR_READING_STRUCT *reading);
 void shtc3_read_data_and_crc(uint32_t cb);
+void shtc3_step(void);
+void shtc3_set_measure_mode(SHTC3_POWER_TypeDef power, bool clock_stretch);
 
 #endif /* SRC_HEADER_FILES_SHTC3_H_ */
@@ -12,11 +12,7 @@
 #include "em_core.h"
 #include "em_assert.h"
 
-void sleep_open();
-void sleep_block_mode(uint32_t EM);
-void sleep_unblock_mode(uint32_t EM);
-void enter_sleep();
-uint32_t current_block_energy_mode(void);
+//#define SLEEP_PROFILE   // Define here or in the build to profile energy mode residency
 
 #define EM0               0
 #define EM1               1
@@ -25,5 +21,43 @@ uint32_t current_block_energy_mode(void);
 #define EM4               4
 #define MAX_ENERGY_MODES  5
 
+#ifdef SLEEP_PROFILE
+#include "em_timer.h"
+
+#define SLEEP_PROFILE_TIMER     WTIMER0 // 32-bit, times EM0 and EM1 to the microsecond
+#define SLEEP_PROFILE_CLOCK     cmuClock_WTIMER0
+#define SLEEP_PROFILE_PRESCALE  timerPrescale16
+#define SLEEP_PROFILE_DIVISOR   16u
+#endif
+
+// Who holds a block, so a profile can tell which blocker kept the core awake
+typedef enum {
+  SLEEP_CALLER_I2C0,
+  SLEEP_CALLER_I2C1,
+  SLEEP_CALLER_LETIMER,
+  SLEEP_CALLER_LEUART,
+  SLEEP_NUM_CALLERS,
+} SLEEP_CALLER_TypeDef;
+
+#ifdef SLEEP_PROFILE
+typedef struct {
+  uint64_t residency_us[MAX_ENERGY_MODES]; // Time spent in each mode, EM0 is time awake
+  uint32_t wakes[MAX_ENERGY_MODES]; // Times the core slept in each mode and woke up
+  uint32_t blocks[SLEEP_NUM_CALLERS]; // sleep_block_mode calls per caller
+  uint32_t unblocks[SLEEP_NUM_CALLERS]; // sleep_unblock_mode calls per caller
+} SLEEP_PROFILE_STRUCT;
+#endif
+
+void sleep_open();
+void sleep_block_mode(uint32_t EM, SLEEP_CALLER_TypeDef caller);
+void sleep_unblock_mode(uint32_t EM, SLEEP_CALLER_TypeDef caller);
+void enter_sleep();
+uint32_t current_block_energy_mode(void);
+
+#ifdef SLEEP_PROFILE
+void sleep_profile_get(SLEEP_PROFILE_STRUCT *profile);
+void sleep_profile_reset(void);
+#endif
+
 
 #endif /* SRC_HEADER_FILES_SLEEP_ROUTINES_H_ */
@@ -0,0 +1,47 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SWTIMER_HG
+#define SWTIMER_HG
+
+/* System include statements */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_core.h"
+#include "em_assert.h"
+
+/* The developer's include statements */
+#include "letimer.h"
+#include "scheduler.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef struct SWTIMER_STRUCT SWTIMER_STRUCT;
+
+struct SWTIMER_STRUCT {
+  uint32_t deadline; // LETIMER tick of the next expiry
+  uint32_t period; // Ticks between expiries, 0 for a one-shot timer
+  uint32_t cb; // Event scheduled on every expiry
+  bool active; // Timer is in the deadline list
+  SWTIMER_STRUCT *next; // Timer with the next later deadline
+};
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void swtimer_open(void);
+void swtimer_start(SWTIMER_STRUCT *timer, uint32_t delay_ms, uint32_t period_ms, uint32_t cb);
+void swtimer_cancel(SWTIMER_STRUCT *timer);
+bool swtimer_active(const SWTIMER_STRUCT *timer);
+void swtimer_expire(void);
+
+#endif
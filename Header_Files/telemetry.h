@@ -0,0 +1,55 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef TELEMETRY_HG
+#define TELEMETRY_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+/* Silicon Labs include statements */
+#include "em_assert.h"
+#include "em_core.h"
+
+/* The developer's include statements */
+#include "brd_config.h"
+#include "leuart.h"
+#include "crc8.h"
+#include "sample_buffer.h"
+#include "fusion.h"
+#include "alarm.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TELEMETRY_BAUDRATE        9600
+#define TELEMETRY_FRAMES          8     // Frames queued for the link
+#define TELEMETRY_SYNC            0xA5  // First byte of every frame
+#define TELEMETRY_CRC_INIT        0x00
+#define TELEMETRY_MAX_PAYLOAD     sizeof(SAMPLE_BLOCK)
+#define TELEMETRY_OVERHEAD        4     // Sync, type, length and CRC-8 of type to payload
+#define TELEMETRY_ESTIMATE_BYTES  14    // Humidity, temp, timestamp, sources, drift
+#define TELEMETRY_ALARM_BYTES     10    // Alarm id, active, value, timestamp
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  TELEMETRY_FRAME_ESTIMATE = 1, // Fused estimate of one sample
+  TELEMETRY_FRAME_BLOCK = 2, // Delta/varint sample block as buffered
+  TELEMETRY_FRAME_ALARM = 3, // Alarm raised or cleared
+} TELEMETRY_FRAME_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void telemetry_open(void);
+bool telemetry_send_estimate(const FUSION_ESTIMATE_STRUCT *estimate);
+bool telemetry_send_block(const SAMPLE_BLOCK *block);
+bool telemetry_send_alarm(const ALARM_EVENT_STRUCT *event, uint32_t timestamp);
+uint32_t telemetry_space(void);
+uint32_t telemetry_dropped(void);
+
+#endif
@@ -2,7 +2,7 @@
  * @file HW_delay.c
  * @author Unknown
  * @date 9/18/2022
- * @brief Performs hardware delays of variable length
+ * @brief Schedules events after delays of variable length
  *
  ****************************************************/
 
@@ -14,6 +14,9 @@
 
 //** User Include Files
 #include "HW_delay.h"
+#include "letimer.h"
+#include "scheduler.h"
+#include "swtimer.h"
 
 //***********************************************************************************
 // defined files
@@ -23,6 +26,7 @@
 //***********************************************************************************
 // private variables
 //***********************************************************************************
+static SWTIMER_STRUCT delay_slots[TIMER_DELAY_SLOTS]; // One-shot timers of the pending delays
 
 
 //***********************************************************************************
@@ -41,33 +45,50 @@
 
 /***************************************************************************//**
  * @brief
- *   Performs timer delay of specified milliseconds
+ *   Clears all pending asynchronous delays.
+ *
+ * @details
+ *   Asynchronous delays are one-shot software timers, so the LETIMER must be
+ *   opened and started before timer_delay_async() is used.
+ *
+ * @note
+ *   This function should be called once before timer_delay_async(), after
+ *   swtimer_open().
+ *
+ ******************************************************************************/
+void timer_delay_open(void){
+	for (int i = 0; i < TIMER_DELAY_SLOTS; i++) {
+		delay_slots[i].active = false;
+	}
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Schedules an event after a delay of specified milliseconds
  *
  * @param[in] ms_delay
- *  Timer delay in milliseconds.
+ *  Delay in milliseconds.
+ *
+ * @param[in] cb
+ *  Event to schedule once the delay has expired.
  *
  * @details
- *   Hardware delays can be important in waiting for devices to respond
+ *   This function returns immediately. The delay is timed by LETIMER0 so the
+ *   core can sleep in EM2/EM3 while it waits.
  *
  * @note
- *   This function can be called at any time.
+ *   The event may be scheduled a few milliseconds late but never early.
  *
  ******************************************************************************/
-void timer_delay(uint32_t ms_delay){
-	uint32_t timer_clk_freq = CMU_ClockFreqGet(cmuClock_HFPER);
-	uint32_t delay_count = ms_delay *(timer_clk_freq/1000) / 1024;
-	CMU_ClockEnable(cmuClock_TIMER0, true);
-	TIMER_Init_TypeDef delay_counter_init = TIMER_INIT_DEFAULT;
-		delay_counter_init.oneShot = true;
-		delay_counter_init.enable = false;
-		delay_counter_init.mode = timerModeDown;
-		delay_counter_init.prescale = timerPrescale1024;
-		delay_counter_init.debugRun = false;
-	TIMER_Init(TIMER0, &delay_counter_init);
-	TIMER0->CNT = delay_count;
-	TIMER_Enable(TIMER0, true);
-	while (TIMER0->CNT != 00);
-	TIMER_Enable(TIMER0, false);
-	CMU_ClockEnable(cmuClock_TIMER0, false);
-}
+void timer_delay_async(uint32_t ms_delay, uint32_t cb){
+	CORE_DECLARE_IRQ_STATE;
+	CORE_ENTER_CRITICAL();
+	int slot = 0;
+	while (slot < TIMER_DELAY_SLOTS && swtimer_active(&delay_slots[slot])) {
+		slot++;
+	}
+	EFM_ASSERT(slot < TIMER_DELAY_SLOTS);
 
+	swtimer_start(&delay_slots[slot], ms_delay, 0, cb);
+	CORE_EXIT_CRITICAL();
+}
@@ -8,175 +8,215 @@
 
 #include "SI7021.h"
 
-static uint32_t hum_bytes;
-static uint32_t temp_bytes;
-static uint32_t user_settings_bytes;
+static void si7021_decode(const uint8_t *raw, SENSOR_READING_STRUCT *reading);
+
+static uint8_t user_settings_write[1] = { SI7021_USER_SETTINGS };
+
+static const SENSOR_DESCRIPTOR_STRUCT si7021_desc = {
+  .which_i2c = SI7021_WHICH_I2C,
+  .device_address = SI7021_DEVICE_ADDR,
+  .startup_time = SI7021_STARTUP_TIME,
+  .crc_init = SI7021_CRC_INIT,
+  .decode = si7021_decode,
+};
+
+// Writes the user settings and reads them back
+static const SENSOR_STEP_STRUCT si7021_init_sequence[] = {
+  SENSOR_WRITE(SI7021_WRITE_USER_CMD, 1, user_settings_write, 1),
+  SENSOR_READ(SI7021_READ_USER_CMD, 1, 1, SI7021_RAW_USER, false),
+  SENSOR_END,
+};
+
+// The user settings are lost at every power-down, so they are written first.
+// The temperature is the one measured during the humidity conversion. The
+// read header is NACKed until the conversion is done.
+static const SENSOR_STEP_STRUCT si7021_measure_polled[] = {
+  SENSOR_WRITE(SI7021_WRITE_USER_CMD, 1, user_settings_write, 1),
+  SENSOR_READ(SI7021_HUM_CMD, 1, SI7021_MEASURE_BYTES, SI7021_RAW_HUM, true),
+  SENSOR_READ(SI7021_TEMP_FROM_RH_CMD, 1, 2, SI7021_RAW_TEMP, false),
+  SENSOR_END,
+};
+
+// Same measurement, but the conversion is waited out with the bus idle. The
+// delay follows the resolution set by si7021_set_resolution().
+#define SI7021_TIMED_WAIT_STEP  2
+static SENSOR_STEP_STRUCT si7021_measure_timed[] = {
+  SENSOR_WRITE(SI7021_WRITE_USER_CMD, 1, user_settings_write, 1),
+  SENSOR_WRITE(SI7021_HUM_CMD, 1, NULL, 0),
+  SENSOR_DELAY(SI7021_CONVERSION_TIME(SI7021_RES_BITS(SI7021_USER_SETTINGS))),
+  SENSOR_READ(0x00, 0, SI7021_MEASURE_BYTES, SI7021_RAW_HUM, true),
+  SENSOR_READ(SI7021_TEMP_FROM_RH_CMD, 1, 2, SI7021_RAW_TEMP, false),
+  SENSOR_END,
+};
+
+static SENSOR_STRUCT si7021;
+static const SENSOR_STEP_STRUCT *si7021_measure = si7021_measure_timed;
+
+/***************************************************************************//**
+ * @brief
+ *   Converts the raw bytes of a measurement.
+ *
+ * @details
+ *   Uses the calibration equations from the SI7021 datasheet,
+ *   RH = 125 * code / 65536 - 6 and T = 175.72 * code / 65536 - 46.85,
+ *   scaled by 100 using an integer multiply and shift.
+ *
+ * @param[in] raw
+ *   Bytes read by the measure sequences
+ *
+ * @param[out] reading
+ *   Decoded reading
+ ******************************************************************************/
+static void si7021_decode(const uint8_t *raw, SENSOR_READING_STRUCT *reading) {
+  reading->humidity_raw = (raw[SI7021_RAW_HUM] << 8) | raw[SI7021_RAW_HUM + 1];
+  reading->temp_raw = (raw[SI7021_RAW_TEMP] << 8) | raw[SI7021_RAW_TEMP + 1];
+  reading->humidity = (int32_t)((SI7021_HUM_GAIN * reading->humidity_raw) >> 16) + SI7021_HUM_OFFSET;
+  reading->temp = (int32_t)((SI7021_TEMP_GAIN * reading->temp_raw) >> 16) + SI7021_TEMP_OFFSET;
+}
 
 /***************************************************************************//**
  * @brief
  *   Initializes the SI7021 sensor.
  *
  * @details
- *   Initializes the SI7021 sensor including clock tree configuration and GPIO setup.
- *   Also changes settings of the SI7021 and verifies it using I2C.
+ *   Opens the SI7021 and its I2C bus through the sensor engine. Returns right
+ *   away, the SI7021 is configured by si7021_configure() once it has started
+ *   up.
  *
  * @note
  *   This function should be called before read or write operations are called.
  *
+ * @param[in] step_cb
+ *   Callback code scheduled when a read can continue. Its handler must call
+ *   si7021_step().
+ ******************************************************************************/
+void si7021_i2c_open(uint32_t step_cb) {
+  sensor_open(&si7021, &si7021_desc, step_cb);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Writes the user settings of the SI7021 and reads them back.
+ *
+ * @details
+ *   Returns right away. The settings read back are posted with the callback
+ *   and can be checked with si7021_get_user_settings().
+ *
+ * @note
+ *   This function should be called once the SI7021 has started up, before
+ *   the first read.
+ *
  * @param[in] cb
  *   Callback code to verify user settings changes
  ******************************************************************************/
-void si7021_i2c_open(uint32_t cb) {
-  timer_delay(SI7021_STARTUP_TIME);
-
-  I2C_OPEN_STRUCT i2c_config;
-
-  i2c_config.master = true;
-  i2c_config.enable = true;
-  i2c_config.freq = I2C_FREQ_FAST_MAX;
-  i2c_config.clhr = i2cClockHLRAsymetric;
-
-  if (SI7021_WHICH_I2C == 0) {
-    i2c_config.scl_route_pin = I2C0_SCL_ROUTE;
-    i2c_config.sda_route_pin = I2C0_SDA_ROUTE;
-    i2c_open(I2C0, &i2c_config);
-  } else if (SI7021_WHICH_I2C == 1) {
-    i2c_config.scl_route_pin = I2C1_SCL_ROUTE;
-    i2c_config.sda_route_pin = I2C1_SDA_ROUTE;
-    i2c_open(I2C1, &i2c_config);
-  } else {
-    EFM_ASSERT(false);
-  }
-
-  // Configure correct User settings by performing I2C write
-  uint32_t data_to_write = SI7021_USER_SETTINGS;
-
-  I2C_START_STRUCT i2c_start_struct;
-  i2c_start_struct.which_i2c = SI7021_WHICH_I2C;
-  i2c_start_struct.comm_method = I2C_WRITE;
-  i2c_start_struct.device_address = SI7021_DEVICE_ADDR;
-  i2c_start_struct.register_address = SI7021_WRITE_USER_CMD;
-  i2c_start_struct.num_bytes = 1;
-  i2c_start_struct.finished_callback = 0x00;
-  i2c_start_struct.data = &data_to_write;
-  i2c_start_struct.num_register_bytes = 1;
-
-  i2c_start(&i2c_start_struct);
-  timer_delay(10);
-
-
-  // Configure correct User settings by performing I2C read
-
-  user_settings_bytes = 0;
-
-  i2c_start_struct.which_i2c = SI7021_WHICH_I2C;
-  i2c_start_struct.comm_method = I2C_READ;
-  i2c_start_struct.device_address = SI7021_DEVICE_ADDR;
-  i2c_start_struct.register_address = SI7021_READ_USER_CMD;
-  i2c_start_struct.num_bytes = 1;
-  i2c_start_struct.finished_callback = cb;
-  i2c_start_struct.data = &user_settings_bytes;
-  i2c_start_struct.num_register_bytes = 1;
-
-  i2c_start(&i2c_start_struct);
-  timer_delay(10);
-
+void si7021_configure(uint32_t cb) {
+  sensor_run(&si7021, si7021_init_sequence, cb);
 }
 
 /***************************************************************************//**
  * @brief
- *   Reads relative humidity via I2C from SI7021
+ *   Selects how si7021_read_hum_and_temp() waits for the conversion.
  *
  * @details
- *   Initiates an I2C read using the appropriate commands and schedules the callback
- *   upon completion
+ *   Timed conversions send the measure command, wait SI7021_CONVERSION_TIME
+ *   of the selected resolution on the LETIMER and only then read, so the bus
+ *   stays idle and the core can sleep in EM2 during the conversion. Polled
+ *   conversions resend the read header until the SI7021 stops NACKing it,
+ *   which keeps the bus and the I2C interrupt busy for the whole conversion
+ *   but returns the reading as soon as it is ready.
  *
  * @note
- *   This function should be called after SI7021 has been opened.
+ *   Timed conversions are used by default. The new mode is used from the
+ *   next read on.
  *
- * @param[in] cb
- *  Callback event which is triggered upon read completion.
+ * @param[in] timed
+ *   True to wait out the conversion time, false to poll.
  ******************************************************************************/
-void si7021_read_humidity(uint32_t cb) {
-  hum_bytes = 0;
-
-  I2C_START_STRUCT i2c_start_struct;
-  i2c_start_struct.which_i2c = SI7021_WHICH_I2C;
-  i2c_start_struct.comm_method = I2C_READ;
-  i2c_start_struct.device_address = SI7021_DEVICE_ADDR;
-  i2c_start_struct.register_address = SI7021_HUM_CMD;
-  i2c_start_struct.num_bytes = 2;
-  i2c_start_struct.finished_callback = cb;
-  i2c_start_struct.data = &hum_bytes;
-  i2c_start_struct.num_register_bytes = 1;
-
-  i2c_start(&i2c_start_struct);
+void si7021_set_timed_conversion(bool timed) {
+  si7021_measure = timed ? si7021_measure_timed : si7021_measure_polled;
 }
 
 /***************************************************************************//**
  * @brief
- *   Reads temperature via I2C from SI7021
+ *   Selects the measurement resolution.
  *
  * @details
- *   Initiates an I2C read using the appropriate commands and schedules the callback
- *   upon completion
+ *   The resolution bits are written with the rest of the user settings at
+ *   the start of every read, and the timed conversion wait follows them.
+ *   Lower resolutions convert faster, so the sensor is powered for less time.
  *
  * @note
- *   This function should be called after SI7021 has been opened.
+ *   Must not be called while a read is running. The new resolution is used
+ *   from the next read on.
  *
- * @param[in] cb
- *  Callback event which is triggered upon read completion.
+ * @param[in] res
+ *   One of the SI7021_RES_ values.
  ******************************************************************************/
-void si7021_read_temp(uint32_t cb) {
-  temp_bytes = 0;
-
-  I2C_START_STRUCT i2c_start_struct;
-  i2c_start_struct.which_i2c = SI7021_WHICH_I2C;
-  i2c_start_struct.comm_method = I2C_READ;
-  i2c_start_struct.device_address = SI7021_DEVICE_ADDR;
-  i2c_start_struct.register_address = SI7021_TEMP_CMD;
-  i2c_start_struct.num_bytes = 2;
-  i2c_start_struct.finished_callback = cb;
-  i2c_start_struct.data = &temp_bytes;
-  i2c_start_struct.num_register_bytes = 1;
-
-  i2c_start(&i2c_start_struct);
+void si7021_set_resolution(uint32_t res) {
+  EFM_ASSERT(res <= SI7021_RES_RH11_T11);
+  EFM_ASSERT(!si7021.busy);
+
+  user_settings_write[0] = (SI7021_USER_SETTINGS & ~SI7021_RES_MASK) | SI7021_RES_SETTINGS(res);
+  si7021_measure_timed[SI7021_TIMED_WAIT_STEP].delay = SI7021_CONVERSION_TIME(res);
 }
 
 /***************************************************************************//**
  * @brief
- *   Returns the relative humidity as a percent (%)
+ *   Reads relative humidity and temperature via I2C from SI7021
  *
  * @details
- *   Takes the raw bytes from the sensor and converts it into a percent relative humidity
- *   value using a calibration equation from the SI7021 datasheet.
+ *   Every humidity conversion also measures the temperature. The user settings
+ *   write, the humidity read and the read of that temperature are chained, so
+ *   they run back to back in one I2C queue slot. In timed mode the chain is
+ *   split by the conversion time and continued by si7021_step(). The callback
+ *   is scheduled once all have finished.
  *
  * @note
- *   This function should be called after si7021_read_humidity is called.
+ *   This function should be called after SI7021 has been opened. The
+ *   temperature read this way has no checksum.
  *
- * @return
- *   The relative humidity as a percent (%)
+ * @param[in] cb
+ *  Callback event which is triggered upon read completion.
  ******************************************************************************/
-float si7021_get_humidity() {
-  return ((125*(float)hum_bytes)/65536.0) - 6.0;
+void si7021_read_hum_and_temp(uint32_t cb) {
+  sensor_run(&si7021, si7021_measure, cb);
 }
 
 /***************************************************************************//**
  * @brief
- *   Returns the temperature in degrees Celcius.
+ *   Continues a read once its conversion time has passed.
+ *
+ * @note
+ *   This function should be called from the handler of the step callback
+ *   passed to si7021_i2c_open().
+ ******************************************************************************/
+void si7021_step(void) {
+  sensor_step(&si7021);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Gets the humidity and temperature reading carried by a read's message.
  *
  * @details
- *   Takes the raw bytes from the sensor and converts it into degrees Celcius
- *   value using a calibration equation from the SI7021 datasheet.
+ *   Humidity is in hundredths of a percent and temperature in hundredths of a
+ *   degree Celcius. The raw codes are returned along with them.
  *
  * @note
- *   This function should be called after si7021_read_humidity is called.
+ *   This function should be called from the handler of the callback passed
+ *   to si7021_read_hum_and_temp, with the message received for it.
+ *
+ * @param[in] message
+ *   Message received for the read's callback
+ *
+ * @param[out] reading
+ *   Decoded reading, left untouched if the read failed
  *
  * @return
- *   The temperature in degrees Celcius.
+ *   True if the read finished and passed its checksum.
  ******************************************************************************/
-float si7021_get_temp() {
-  return ((175.72*(float)temp_bytes)/65536.0) - 46.85;
+bool si7021_get_reading(const SCHEDULER_MESSAGE_STRUCT *message, SENSOR_READING_STRUCT *reading) {
+  return sensor_get_reading(&si7021, message, reading);
 }
 
 /***************************************************************************//**
@@ -185,16 +225,19 @@ float si7021_get_temp() {
  *
  * @details
  *   The User Settings on the I2C controls the output bit resolution,
- *   on-board heater and more. This function returns the sensor's current
- *   configuration after the sensor has been opened.
+ *   on-board heater and more. This function returns the sensor's
+ *   configuration as read back when the sensor was opened.
  *
  * @note
- *   This function should be called after SI7021 has been successfully opened.
+ *   This function should be called from the handler of the callback passed
+ *   to si7021_i2c_open, with the message received for it.
+ *
+ * @param[in] message
+ *   Message received for the open's callback
  *
  * @return
  *   The SI7021 User Settings byte
  ******************************************************************************/
-uint32_t si7021_get_user_settings() {
-  return user_settings_bytes;
+uint32_t si7021_get_user_settings(const SCHEDULER_MESSAGE_STRUCT *message) {
+  return message->payload[SI7021_RAW_USER];
 }
-
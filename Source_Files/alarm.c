@@ -0,0 +1,196 @@
+/*****************************************************
+ * @file alarm.c
+ * @author Branson Camp
+ * @date 12/19/2022
+ * @brief Raises and clears threshold alarms with
+ * hysteresis and posts an event on every transition.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "alarm.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static const ALARM_STRUCT default_alarms[ALARM_COUNT] = {
+  [ALARM_HUMIDITY_HIGH] = {
+    .channel = ALARM_CHANNEL_HUMIDITY,
+    .above = true,
+    .level = ALARM_HUMIDITY_HIGH_LEVEL,
+    .band = ALARM_HUMIDITY_HIGH_BAND,
+  },
+  [ALARM_CONDENSATION] = {
+    .channel = ALARM_CHANNEL_HUMIDITY,
+    .above = true,
+    .level = ALARM_CONDENSATION_LEVEL,
+    .band = ALARM_CONDENSATION_BAND,
+  },
+  [ALARM_TEMP_HIGH] = {
+    .channel = ALARM_CHANNEL_TEMP,
+    .above = true,
+    .level = ALARM_TEMP_HIGH_LEVEL,
+    .band = ALARM_TEMP_HIGH_BAND,
+  },
+  [ALARM_TEMP_LOW] = {
+    .channel = ALARM_CHANNEL_TEMP,
+    .above = false,
+    .level = ALARM_TEMP_LOW_LEVEL,
+    .band = ALARM_TEMP_LOW_BAND,
+  },
+};
+
+static ALARM_STRUCT alarms[ALARM_COUNT];
+static uint32_t active_alarms; // Bit per raised alarm
+static uint32_t alarm_event;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static bool alarm_next_state(const ALARM_STRUCT *alarm, bool active, int32_t value);
+
+/***************************************************************************//**
+ * @brief
+ *   Applies an alarm's level and band to a value.
+ *
+ * @details
+ *   An inactive alarm is raised once the value reaches the level. An active
+ *   one only clears once the value is more than the band back past the level,
+ *   so a reading that hovers around the level does not toggle it.
+ *
+ * @return
+ *   Whether the alarm is active after the value.
+ ******************************************************************************/
+static bool alarm_next_state(const ALARM_STRUCT *alarm, bool active, int32_t value) {
+  if (alarm->above) {
+      return active ? value >= alarm->level - alarm->band : value >= alarm->level;
+  }
+  return active ? value <= alarm->level + alarm->band : value <= alarm->level;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Loads the default alarms, all cleared.
+ *
+ * @note
+ *   This function should be called once after scheduler_open().
+ *
+ * @param[in] alarm_cb
+ *  Callback code posted with a message on every transition. Its handler must
+ *  call alarm_receive().
+ ******************************************************************************/
+void alarm_open(uint32_t alarm_cb) {
+  _Static_assert(sizeof(ALARM_EVENT_STRUCT) <= SCHEDULER_PAYLOAD_BYTES, "An alarm event must fit in a scheduler message");
+
+  for (uint32_t i = 0; i < ALARM_COUNT; i++) {
+      alarms[i] = default_alarms[i];
+  }
+  active_alarms = 0;
+  alarm_event = alarm_cb;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Changes the level and band of an alarm.
+ *
+ * @details
+ *   The alarm keeps its state. The next update raises or clears it against
+ *   the new level.
+ *
+ * @param[in] id
+ *  Alarm to change
+ *
+ * @param[in] level
+ *  Value the alarm is raised at
+ *
+ * @param[in] band
+ *  Hysteresis, not negative
+ ******************************************************************************/
+void alarm_configure(ALARM_ID_TypeDef id, int32_t level, int32_t band) {
+  EFM_ASSERT(id < ALARM_COUNT);
+  EFM_ASSERT(band >= 0);
+  alarms[id].level = level;
+  alarms[id].band = band;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Runs every alarm against the values of a sample.
+ *
+ * @details
+ *   Only alarms whose state changes post a message, so most samples post
+ *   nothing. An alarm only changes state once its message is queued. If the
+ *   message queue is full, the alarm keeps its old state and the next sample
+ *   posts the change again, so the handler never misses a transition.
+ *
+ * @param[in] humidity
+ *  centi-%RH
+ *
+ * @param[in] temp
+ *  centi-C
+ *
+ * @param[in] timestamp
+ *  Time of the sample, passed with the messages
+ ******************************************************************************/
+void alarm_update(int32_t humidity, int32_t temp, uint32_t timestamp) {
+  for (uint32_t i = 0; i < ALARM_COUNT; i++) {
+      int32_t value = (alarms[i].channel == ALARM_CHANNEL_HUMIDITY) ? humidity : temp;
+      bool active = (active_alarms >> i) & 1;
+      bool next = alarm_next_state(&alarms[i], active, value);
+      if (next == active) {
+          continue;
+      }
+
+      ALARM_EVENT_STRUCT event = { .id = i, .active = next, .value = value };
+      if (scheduler_post(alarm_event, &event, sizeof(event), 0, timestamp)) {
+          active_alarms ^= 1u << i;
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Receives the oldest alarm transition.
+ *
+ * @note
+ *   This function should be called once from each dispatch of the alarm
+ *   callback's handler.
+ *
+ * @param[out] event
+ *  Alarm that changed and its new state
+ *
+ * @param[out] timestamp
+ *  Time of the sample that changed it
+ *
+ * @return
+ *   False if no transition was queued.
+ ******************************************************************************/
+bool alarm_receive(ALARM_EVENT_STRUCT *event, uint32_t *timestamp) {
+  SCHEDULER_MESSAGE_STRUCT message;
+  if (!scheduler_receive(alarm_event, &message)) {
+      return false;
+  }
+  memcpy(event, message.payload, sizeof(*event));
+  *timestamp = message.timestamp;
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Checks whether an alarm is raised.
+ ******************************************************************************/
+bool alarm_active(ALARM_ID_TypeDef id) {
+  EFM_ASSERT(id < ALARM_COUNT);
+  return (active_alarms >> id) & 1;
+}
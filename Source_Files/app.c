@@ -22,12 +22,16 @@
 // Static / Private Variables
 //***********************************************************************************
 //static uint32_t humidity_result = 0;
+static bool sensors_configured; // SI7021 settings confirmed, the bring-up is over
+
 
 //***********************************************************************************
 // Private functions
 //***********************************************************************************
 
 static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_route, uint32_t out1_route);
+static void app_register_events(void);
+static void app_store_block(const SAMPLE_BLOCK *block);
 
 //***********************************************************************************
 // Global functions
@@ -39,6 +43,10 @@ static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_r
  *
  * @details
  *   Opens the CMU, GPIO, and LETIMER peripherals. Also starts the LETIMER.
+ *   The sensors are powered first and start up while everything else is
+ *   opened. Nothing here waits for them: the SI7021 is configured from the
+ *   SENSORS_BOOT_CB event once their startup time is over, and the first
+ *   sample follows its confirmation.
  *
  * @note
  *   This function should run once at the start of the program.
@@ -46,14 +54,85 @@ static void app_letimer_pwm_open(float period, float act_period, uint32_t out0_r
  ******************************************************************************/
 void app_peripheral_setup(void){
   scheduler_open(); // Initialize the scheduler
+#ifdef SAMPLE_BENCH
+  bench_open(); // Measure every sample cycle
+#endif
+  app_register_events();
+  gpio_open();
+  sensor_power_open(SENSOR_POWER_CB); // The sensors start up while the rest is opened
   sleep_open(); // Initialize sleep manager
+  sample_buffer_open(SAMPLE_BATCH_SIZE, SAMPLE_BATCH_CB);
+  flash_log_open(); // Continue the log left in flash
   cmu_open();
-  gpio_open();
+  telemetry_open(); // Estimates and blocks stream out of LEUART0
 
   app_letimer_pwm_open(PWM_PER, PWM_ACT_PER, PWM_ROUTE_0, PWM_ROUTE_1);
   letimer_start(LETIMER0, true);   // letimer_start will inform the LETIMER0 peripheral to begin counting.
-  si7021_i2c_open(SI7021_USER_CONFIRM);
-  shtc3_i2c_open();
+  cadence_open(PWM_PER * 1000, HUMIDITY_COMPARE); // Slow down while readings are stable
+  profile_open(); // The buttons switch profiles from here on
+  fusion_open(); // Both sensors are read until they agree
+  alarm_open(ALARM_CB); // Alarms post an event only when they change
+  swtimer_open(); // Software timers run on LETIMER0 COMP1
+  timer_delay_open(); // Asynchronous delays are one-shot software timers
+  i2c_timeout_open(I2C_TIMEOUT_CB); // Stuck transfers are reset and retried
+  si7021_i2c_open(SI7021_STEP_CB);
+  shtc3_i2c_open(SHTC3_STEP_CB);
+  sensor_power_boot(SENSORS_BOOT_CB, sensor_startup_time()); // Bring-up continues from events
+}
+
+/***************************************************************************//**
+ * @brief
+ *  Registers the handler of every application event with the scheduler.
+ *
+ * @details
+ *  Sensor bring-up and read continuations are dispatched before completed
+ *  readings, which are dispatched before the start of a new sample.
+ *
+ * @note
+ *  The buttons only select the sampling profile, so their events are
+ *  dispatched last.
+ *
+ ******************************************************************************/
+static void app_register_events(void){
+  scheduler_register(SI7021_USER_CONFIRM, SCHEDULER_PRIORITY_HIGH, scheduled_si7021_user_confirm);
+  scheduler_register(SHTC3_STEP_CB, SCHEDULER_PRIORITY_HIGH, scheduled_shtc3_step_cb);
+  scheduler_register(SI7021_STEP_CB, SCHEDULER_PRIORITY_HIGH, scheduled_si7021_step_cb);
+  scheduler_register(SENSOR_POWER_CB, SCHEDULER_PRIORITY_HIGH, scheduled_sensor_power_cb);
+  scheduler_register(SENSORS_BOOT_CB, SCHEDULER_PRIORITY_HIGH, scheduled_sensors_boot_cb);
+  scheduler_register(SENSORS_READY_CB, SCHEDULER_PRIORITY_HIGH, scheduled_sensors_ready_cb);
+  scheduler_register(I2C_TIMEOUT_CB, SCHEDULER_PRIORITY_HIGH, scheduled_i2c_timeout_cb);
+  scheduler_register(ALARM_CB, SCHEDULER_PRIORITY_HIGH, scheduled_alarm_cb);
+
+  scheduler_register(SI7021_READ_CB, SCHEDULER_PRIORITY_MEDIUM, scheduled_si7021_read_cb);
+  scheduler_register(SHTC3_READ_CB, SCHEDULER_PRIORITY_MEDIUM, scheduled_shtc3_read_irq_cb);
+  scheduler_register(SAMPLE_DONE_CB, SCHEDULER_PRIORITY_MEDIUM, scheduled_sample_done_cb);
+
+  scheduler_register(SAMPLE_BATCH_CB, SCHEDULER_PRIORITY_LOW, scheduled_sample_batch_cb);
+  scheduler_register(LETIMER0_UF_CB, SCHEDULER_PRIORITY_LOW, scheduled_letimer0_uf_cb);
+  scheduler_register(LETIMER0_COMP0_CB, SCHEDULER_PRIORITY_LOW, scheduled_letimer0_comp0_cb);
+  scheduler_register(LETIMER0_COMP1_CB, SCHEDULER_PRIORITY_LOW, scheduled_letimer0_comp1_cb);
+  scheduler_register(GPIO_EVEN_IRQ_CB, SCHEDULER_PRIORITY_LOW, scheduled_gpio_even_irq_cb);
+  scheduler_register(GPIO_ODD_IRQ_CB, SCHEDULER_PRIORITY_LOW, scheduled_gpio_odd_irq_cb);
+}
+
+/***************************************************************************//**
+ * @brief
+ *  Keeps a sample block drained from the sample buffer.
+ *
+ * @details
+ *  The block always goes to the flash log. It is also sent over telemetry
+ *  while the link has room to spare, so a slow link drops blocks before
+ *  estimates.
+ *
+ * @param[in] block
+ *  Block drained from the sample buffer
+ *
+ ******************************************************************************/
+static void app_store_block(const SAMPLE_BLOCK *block){
+  flash_log_append(block);
+  if (telemetry_space() > TELEMETRY_ESTIMATE_RESERVE) {
+      telemetry_send_block(block);
+  }
 }
 
 /***************************************************************************//**
@@ -90,14 +169,14 @@ void app_letimer_pwm_open(float period, float act_period, uint32_t out0_route, u
   letimer_pwm_struct.debugRun = false;
   letimer_pwm_struct.out_pin_route0 = out0_route;
   letimer_pwm_struct.out_pin_route1 = out1_route;
-  letimer_pwm_struct.out_pin_0_en = false; // Was set to true for lab 3
+  letimer_pwm_struct.out_pin_0_en = false; // Was set to true for lab 3, COMP1 now holds delay deadlines
   letimer_pwm_struct.out_pin_1_en = false;
   letimer_pwm_struct.period = period;
   letimer_pwm_struct.active_period = act_period;
 
   // Interrupts
   letimer_pwm_struct.comp0_irq_enable = false;
-  letimer_pwm_struct.comp1_irq_enable = true;
+  letimer_pwm_struct.comp1_irq_enable = false; // COMP1 is used for asynchronous delays
   letimer_pwm_struct.uf_irq_enable = true;
   letimer_pwm_struct.comp0_cb = LETIMER0_COMP0_CB;
   letimer_pwm_struct.comp1_cb = LETIMER0_COMP1_CB;
@@ -111,17 +190,24 @@ void app_letimer_pwm_open(float period, float act_period, uint32_t out0_route, u
  *   Callback function for the underflow interrupt.
  *
  * @details
- *   Not currently doing anything except assert that the event is no longer
- *   scheduled.
+ *   Starts a sample by powering up the sensors. The active sensors are read
+ *   once they are ready. A newly selected profile is applied first, unless
+ *   the previous sample is still running. Underflows during the bring-up are
+ *   skipped, the bring-up takes the first sample itself.
  *
  * @note
- *   This function runs once the scheduled task is checked in main.c
+ *   This function runs once the scheduled task is dispatched in main.c
  *
  ******************************************************************************/
 void scheduled_letimer0_uf_cb (void) {
-  si7021_read_humidity(SI7021_READ_HUM_CB);
-  si7021_read_temp(SI7021_READ_TEMP_CB);
-  shtc3_read_data_and_crc(SHTC3_READ_CB);
+  BENCH_CYCLE(); // A sample cycle runs from one underflow to the next
+  if (!sensors_configured) {
+      return; // The SI7021 is still being configured
+  }
+  if (!sensor_power_is_on()) {
+      profile_apply_pending(); // Sample boundary, no read is running
+  }
+  sensor_power_acquire(SENSORS_READY_CB);
   EFM_ASSERT(!(get_scheduled_events() & LETIMER0_UF_CB));
 }
 
@@ -130,14 +216,14 @@ void scheduled_letimer0_uf_cb (void) {
  *   Callback function for the COMP0 interrupt.
  *
  * @details
- *   Not currently doing anything except assert that the event is no longer
- *   scheduled.
+ *   The COMP0 interrupt is not enabled, so this callback should never run.
  *
  * @note
- *   This function runs once the scheduled task is checked in main.c
+ *   This function runs once the scheduled task is dispatched in main.c
  *
  ******************************************************************************/
 void scheduled_letimer0_comp0_cb (void) {
+  EFM_ASSERT(false); // This interrupt should never happen
   EFM_ASSERT(!(get_scheduled_events() & LETIMER0_COMP0_CB));
 }
 
@@ -150,7 +236,7 @@ void scheduled_letimer0_comp0_cb (void) {
  *   scheduled.
  *
  * @note
- *   This function runs once the scheduled task is checked in main.c
+ *   This function runs once the scheduled task is dispatched in main.c
  *
  ******************************************************************************/
 void scheduled_letimer0_comp1_cb (void) {
@@ -162,21 +248,16 @@ void scheduled_letimer0_comp1_cb (void) {
  *   Callback function for the button 1 interrupt.
  *
  * @details
- *   Increments the current block energy mode. Wraps around to EM0 if
- *   current block energy mode is EM4
+ *   Selects the next sampling profile. Wraps around to the first profile
+ *   after the last one.
  *
  * @note
- *   This function runs when button 1 is pressed.
+ *   This function runs when button 1 is pressed. The profile takes effect at
+ *   the next sample.
  *
  ******************************************************************************/
 void scheduled_gpio_odd_irq_cb (void) {
-  uint32_t current_block_em = current_block_energy_mode();
-  sleep_unblock_mode(current_block_em);
-  if (current_block_em < EM4) {
-      sleep_block_mode(current_block_em + 1);
-  } else {
-      sleep_block_mode(EM0);
-  }
+  profile_next();
   EFM_ASSERT(!(get_scheduled_events() & GPIO_ODD_IRQ_CB));
 }
 
@@ -185,94 +266,104 @@ void scheduled_gpio_odd_irq_cb (void) {
  *   Callback function for the button 0 interrupt.
  *
  * @details
- *   Decrements the current block energy mode. Wraps around to EM4 if
- *   current block energy mode is EM0
+ *   Selects the previous sampling profile. Wraps around to the last profile
+ *   before the first one.
  *
  * @note
- *   This function runs when button 0 is pressed.
+ *   This function runs when button 0 is pressed. The profile takes effect at
+ *   the next sample.
  *
  ******************************************************************************/
 void scheduled_gpio_even_irq_cb (void) {
-  uint32_t current_block_em = current_block_energy_mode();
-  sleep_unblock_mode(current_block_em);
-  if (current_block_em > EM0) {
-    sleep_block_mode(current_block_em - 1);
-  } else {
-    sleep_block_mode(EM4);
-  }
+  profile_previous();
   EFM_ASSERT(!(get_scheduled_events() & GPIO_EVEN_IRQ_CB));
 }
 
 /***************************************************************************//**
  * @brief
- *   Callback function for the SI7021's humidity read completion event.
+ *   Callback function for the SI7021's humidity and temperature read
+ *   completion event.
  *
  * @details
- *   Gets the humidity as a percent value and activates an LED if the value is greater
- *   or equal to 30.0
+ *   Drops the reading if the read failed or the humidity checksum does not
+ *   match. Otherwise buffers both raw readings and hands the reading to the
+ *   fusion stage.
  *
  * @note
- *   This function runs when the result from si7021_read_humidity is ready.
+ *   This function runs when the result from si7021_read_hum_and_temp is ready.
  *
  ******************************************************************************/
-void scheduled_si7021_read_hum_cb(void) {
-  float humidity_percent = si7021_get_humidity();
-  if (humidity_percent >= HUMIDITY_COMPARE) {
-      // Turn LED0 on
-      GPIO->P[LED0_PORT].DOUT |= 1 << LED0_PIN;
-  } else {
-      // Turn LED0 off
-      GPIO->P[LED0_PORT].DOUT &= ~(1 << LED0_PIN);
+void scheduled_si7021_read_cb(void) {
+  EFM_ASSERT(!(get_scheduled_events() & SI7021_READ_CB));
+  SCHEDULER_MESSAGE_STRUCT message;
+  SENSOR_READING_STRUCT reading;
+  if (!scheduler_receive(SI7021_READ_CB, &message) || !si7021_get_reading(&message, &reading)) {
+      return; // Read failed, fuse the SHTC3 reading alone
   }
 
+  uint32_t now = letimer_get_ticks(LETIMER0); // Buffered in handling order, which keeps times increasing
+  sample_buffer_add(SAMPLE_CH_SI7021_HUM, reading.humidity_raw, now);
+  sample_buffer_add(SAMPLE_CH_SI7021_TEMP, reading.temp_raw, now);
 
-  char hum_result[50];
-  sprintf(hum_result, "%3.1f %% humidity", humidity_percent);
-
-  EFM_ASSERT(!(get_scheduled_events() & SI7021_READ_HUM_CB));
+  fusion_add(FUSION_SI7021, &reading, message.timestamp);
 }
 
 /***************************************************************************//**
  * @brief
- *   Callback function for the SI7021's temperature read completion event.
+ *   Callback function for the SHTC3's temp and RH read completion
  *
  * @details
- *   Gets the temperature in Fahrenheit and stores it in a string.
+ *   Drops the reading if the read or a checksum failed. Otherwise buffers the
+ *   raw readings and hands the reading to the fusion stage.
  *
  * @note
- *   This function runs when the result from si7021_read_temperature is ready.
+ *   This function runs when the result from shtc3_read_data_and_crc is ready.
  *
  ******************************************************************************/
-void scheduled_si7021_read_temp_cb(void) {
-  float temp_c = si7021_get_temp();
-  float temp_f = (temp_c*1.8) + 32.0;
-  EFM_ASSERT(!(get_scheduled_events() & SI7021_READ_TEMP_CB));
+void scheduled_shtc3_read_irq_cb(void) {
+  SCHEDULER_MESSAGE_STRUCT message;
+  SENSOR_READING_STRUCT reading;
+  if (!scheduler_receive(SHTC3_READ_CB, &message) || !shtc3_get_reading(&message, &reading)) {
+      return; // Read failed, drop the reading
+  }
+  uint32_t now = letimer_get_ticks(LETIMER0); // Buffered in handling order, which keeps times increasing
+  sample_buffer_add(SAMPLE_CH_SHTC3_TEMP, reading.temp_raw, now);
+  sample_buffer_add(SAMPLE_CH_SHTC3_HUM, reading.humidity_raw, now);
+  fusion_add(FUSION_SHTC3, &reading, message.timestamp);
+}
 
-  char temp_result[50];
-  sprintf(temp_result, "%3.1f F", temp_f);
+/***************************************************************************//**
+ * @brief
+ *   Callback for the steps of an SI7021 read.
+ *
+ * @details
+ *   Lets the SI7021 driver read the conversion started by
+ *   si7021_read_hum_and_temp.
+ *
+ * @note
+ *   This function runs when the SI7021 conversion time has expired.
+ *
+ ******************************************************************************/
+void scheduled_si7021_step_cb(void) {
+  si7021_step();
+  EFM_ASSERT(!(get_scheduled_events() & SI7021_STEP_CB));
 }
 
 /***************************************************************************//**
  * @brief
- *   Callback function for the SHTC3's temp and RH read completion
+ *   Callback for the steps of an SHTC3 read.
  *
  * @details
- *   Gets the temperature (F) and relative humidity (%) and displays them
- *   as strings.
+ *   Lets the SHTC3 driver continue the read started by shtc3_read_data_and_crc.
  *
  * @note
- *   This function runs when the result from shtc3_read_data_and_crc is ready.
+ *   This function runs when a delay of the SHTC3 read has expired or one of
+ *   its I2C steps is done.
  *
  ******************************************************************************/
-void scheduled_shtc3_read_irq_cb(void) {
-  float temp = 0.0;
-  float hum = 0.0;
-  shtc3_app_get_temp_and_hum(&temp, &hum);
-  float temp_f = (temp*1.8) + 32.0;
-  char other_temp_result[50];
-  sprintf(other_temp_result, "%3.1f F", temp_f);
-  char other_hum_result[50];
-  sprintf(other_hum_result, "%3.1f %% humidity", hum);
+void scheduled_shtc3_step_cb(void) {
+  shtc3_step();
+  EFM_ASSERT(!(get_scheduled_events() & SHTC3_STEP_CB));
 }
 
 /***************************************************************************//**
@@ -282,7 +373,10 @@ void scheduled_shtc3_read_irq_cb(void) {
  *
  * @details
  *   This function is used to check that writes to the SI7021 user settings
- *   were successful.
+ *   were successful. The bring-up is then over and the first sample is taken
+ *   right away, without waiting for the first LETIMER underflow. A read back
+ *   lost to a full message queue runs the configuration again, the sensors
+ *   stay powered by the bring-up until one is confirmed.
  *
  * @note
  *   This function runs when the result from the SI7021 I2C read of user settings
@@ -290,8 +384,176 @@ void scheduled_shtc3_read_irq_cb(void) {
  *
  ******************************************************************************/
 void scheduled_si7021_user_confirm(void) {
-  uint32_t user_settings = si7021_get_user_settings();
+  SCHEDULER_MESSAGE_STRUCT message;
+  if (!scheduler_receive(SI7021_USER_CONFIRM, &message)) {
+      si7021_configure(SI7021_USER_CONFIRM); // Lost to a full message queue
+      return;
+  }
+  uint32_t user_settings = si7021_get_user_settings(&message);
   EFM_ASSERT(user_settings == SI7021_USER_SETTINGS);
+  sensors_configured = true;
+  sensor_power_acquire(SENSORS_READY_CB); // Take the first sample while still powered
+  sensor_power_release(); // Bring-up is done
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Callback for when the sensors have started up after reset.
+ *
+ * @details
+ *   Writes the SI7021 user settings. The SHTC3 needs no configuration.
+ *
+ * @note
+ *   This function runs once, when the power-up started by
+ *   app_peripheral_setup is over.
+ *
+ ******************************************************************************/
+void scheduled_sensors_boot_cb(void) {
+  si7021_configure(SI7021_USER_CONFIRM);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Callback for the end of the sensor power-up time.
+ *
+ * @details
+ *   Lets the sensor power manager hand the powered sensors to the drivers
+ *   waiting for them.
+ *
+ * @note
+ *   This function runs when sensor_power_acquire had to power up the sensors,
+ *   and once after reset for sensor_power_boot.
+ *
+ ******************************************************************************/
+void scheduled_sensor_power_cb(void) {
+  sensor_power_step();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Callback for the I2C transaction timeout check.
+ *
+ * @details
+ *   Resets a bus whose transfer has stalled and retries or fails the
+ *   transfer.
+ *
+ * @note
+ *   This function runs every I2C_TIMEOUT_MS while an I2C bus is busy.
+ *
+ ******************************************************************************/
+void scheduled_i2c_timeout_cb(void) {
+  i2c_timeout_check();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Callback for when the sensors are powered for a sample.
+ *
+ * @details
+ *   Starts the SI7021 read on I2C0 and the SHTC3 read on I2C1 together, so
+ *   both buses run at the same time and the sample takes as long as the
+ *   slower sensor. Sensors inactive in the profile are skipped, and so is the
+ *   SI7021 while the fusion stage trusts the SHTC3 alone. A barrier joins the
+ *   completion events of the sensors read into SAMPLE_DONE_CB.
+ *
+ * @note
+ *   This function runs once sensor_power_acquire is done.
+ *
+ ******************************************************************************/
+void scheduled_sensors_ready_cb(void) {
+  const PROFILE_STRUCT *profile = profile_get();
+  bool read_shtc3 = profile->shtc3_active;
+  bool read_si7021 = profile->si7021_active && (fusion_wants(FUSION_SI7021) || !read_shtc3);
+  uint32_t members = (read_si7021 ? SI7021_READ_CB : 0) | (read_shtc3 ? SHTC3_READ_CB : 0);
+  EFM_ASSERT(members);
+
+  fusion_begin(letimer_get_ticks(LETIMER0));
+  scheduler_barrier(members, SAMPLE_DONE_CB);
+  if (read_si7021) {
+      si7021_read_hum_and_temp(SI7021_READ_CB);
+  }
+  if (read_shtc3) {
+      shtc3_read_data_and_crc(SHTC3_READ_CB);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Callback for when both sensors are done with a sample.
+ *
+ * @details
+ *   Both buses are idle and the SHTC3 is asleep again, so the sensors are
+ *   powered down until the next sample. The sample's readings are fused into
+ *   one estimate, which adapts the sample cadence, is sent over telemetry and
+ *   runs the alarms.
+ *
+ * @note
+ *   This function runs after the read completion callbacks of both sensors.
+ *   If every read failed, the cadence and the alarms are left as they were.
+ *
+ ******************************************************************************/
+void scheduled_sample_done_cb(void) {
+  sensor_power_release();
+
+  FUSION_ESTIMATE_STRUCT estimate;
+  if (fusion_update(&estimate)) {
+      cadence_update(estimate.humidity, estimate.temp);
+      telemetry_send_estimate(&estimate); // Dropped while the link is backed up
+      alarm_update(estimate.humidity, estimate.temp, estimate.timestamp);
+  }
+  EFM_ASSERT(!(get_scheduled_events() & SAMPLE_DONE_CB));
 }
 
+/***************************************************************************//**
+ * @brief
+ *   Callback for when an alarm has been raised or cleared.
+ *
+ * @details
+ *   LED0 follows the high humidity alarm. Every transition is sent over
+ *   telemetry.
+ *
+ * @note
+ *   This function runs once per transition posted by alarm_update(), only
+ *   samples that change an alarm get here.
+ *
+ ******************************************************************************/
+void scheduled_alarm_cb(void) {
+  ALARM_EVENT_STRUCT event;
+  uint32_t timestamp;
+  if (!alarm_receive(&event, &timestamp)) {
+      return;
+  }
+
+  if (event.id == ALARM_HUMIDITY_HIGH) {
+      if (event.active) {
+          // Turn LED0 on
+          GPIO->P[LED0_PORT].DOUT |= 1 << LED0_PIN;
+      } else {
+          // Turn LED0 off
+          GPIO->P[LED0_PORT].DOUT &= ~(1 << LED0_PIN);
+      }
+  }
+  telemetry_send_alarm(&event, timestamp);
+}
 
+/***************************************************************************//**
+ * @brief
+ *   Callback for when a batch of samples is ready in the sample buffer.
+ *
+ * @details
+ *   Drains the sample buffer a block at a time and keeps each block with
+ *   app_store_block(). The blocks stay raw codes, nothing on the device
+ *   needs them decoded: the estimates and alarms come from fusion, and
+ *   whoever reads the flash log or telemetry decodes them there.
+ *
+ * @note
+ *   This function runs once a batch worth of records has been buffered.
+ *
+ ******************************************************************************/
+void scheduled_sample_batch_cb(void) {
+  EFM_ASSERT(!(get_scheduled_events() & SAMPLE_BATCH_CB));
+  SAMPLE_BLOCK block;
+  while (sample_buffer_drain(&block, 1)) {
+      app_store_block(&block);
+  }
+}
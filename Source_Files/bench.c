@@ -0,0 +1,197 @@
+/*****************************************************
+ * @file bench.c
+ * @author Branson Camp
+ * @date 12/13/2022
+ * @brief Measures the interrupts, awake time and bus
+ * time of every sample cycle in SAMPLE_BENCH builds.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "bench.h"
+
+#ifdef SAMPLE_BENCH
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static BENCH_STRUCT bench_results;
+static BENCH_CYCLE_STRUCT bench_current; // Cycle being measured
+static uint32_t counts_per_us; // BENCH_TIMER rate
+static uint32_t cycle_start; // BENCH_TIMER count at the start of the current cycle
+static uint32_t bus_busy_since[2]; // BENCH_TIMER count each bus went busy
+static uint32_t bus_busy_counts[2]; // BENCH_TIMER counts each bus was busy this cycle
+static bool bus_busy[2];
+static bool cycle_started; // False until the first sample cycle
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void bench_max(uint32_t *worst, uint32_t value);
+
+/***************************************************************************//**
+ * @brief
+ *   Keeps the larger of two values.
+ ******************************************************************************/
+static void bench_max(uint32_t *worst, uint32_t value) {
+  if (value > *worst) {
+      *worst = value;
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Starts BENCH_TIMER and clears the results.
+ *
+ * @details
+ *   The timer runs from the HFPER clock, which stops in EM2 and EM3. It
+ *   measures the time spent awake or in EM1, the modes that cost the most
+ *   power, to the microsecond. A bus transfer keeps the core in EM1 or above,
+ *   so the same timer measures the bus time.
+ *
+ * @note
+ *   This function should be called once before the first sample cycle, after
+ *   the HF clock is set up. Only available in a SAMPLE_BENCH build.
+ ******************************************************************************/
+void bench_open(void) {
+  CMU_ClockEnable(BENCH_CLOCK, true);
+  TIMER_Init_TypeDef timer_init = TIMER_INIT_DEFAULT; // Free running up count
+  timer_init.prescale = BENCH_PRESCALE;
+  TIMER_Init(BENCH_TIMER, &timer_init);
+  counts_per_us = CMU_ClockFreqGet(BENCH_CLOCK) / BENCH_DIVISOR / 1000000u;
+  bench_reset();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Counts an interrupt against the current sample cycle.
+ *
+ * @note
+ *   Called through BENCH_ISR() at the top of every interrupt handler.
+ ******************************************************************************/
+void bench_isr(void) {
+  bench_current.isr_count++;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Tracks when an I2C bus starts and stops having transfers queued.
+ *
+ * @details
+ *   Bus time is measured with BENCH_TIMER, which keeps counting while the
+ *   core sleeps in EM1 during a transfer.
+ *
+ * @note
+ *   Called through BENCH_BUS() by the I2C driver with interrupts off.
+ *
+ * @param[in] which_i2c
+ *  false = I2C0, true = I2C1
+ *
+ * @param[in] busy
+ *  True when the bus's first transfer starts, false when its queue drains
+ ******************************************************************************/
+void bench_bus(bool which_i2c, bool busy) {
+  uint32_t now = BENCH_TIMER->CNT;
+  if (busy) {
+      bus_busy_since[which_i2c] = now;
+  } else if (bus_busy[which_i2c]) {
+      bus_busy_counts[which_i2c] += now - bus_busy_since[which_i2c];
+  }
+  bus_busy[which_i2c] = busy;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Closes the current sample cycle and starts the next one.
+ *
+ * @details
+ *   A cycle runs from one LETIMER0 underflow to the next. Its cost is kept as
+ *   the last cycle and folded into the worst case. A bus still busy at the
+ *   boundary is carried over into the next cycle.
+ *
+ * @note
+ *   Called through BENCH_CYCLE() at the start of every sample.
+ ******************************************************************************/
+void bench_cycle(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  uint32_t now = BENCH_TIMER->CNT;
+
+  for (int i = 0; i < 2; i++) {
+      if (bus_busy[i]) {
+          bus_busy_counts[i] += now - bus_busy_since[i];
+          bus_busy_since[i] = now;
+      }
+  }
+
+  if (cycle_started) {
+      bench_current.awake_us = (now - cycle_start) / counts_per_us;
+      bench_current.bus_busy_us[0] = bus_busy_counts[0] / counts_per_us;
+      bench_current.bus_busy_us[1] = bus_busy_counts[1] / counts_per_us;
+      bench_results.last = bench_current;
+      bench_max(&bench_results.worst.isr_count, bench_current.isr_count);
+      bench_max(&bench_results.worst.awake_us, bench_current.awake_us);
+      bench_max(&bench_results.worst.bus_busy_us[0], bench_current.bus_busy_us[0]);
+      bench_max(&bench_results.worst.bus_busy_us[1], bench_current.bus_busy_us[1]);
+      bench_results.cycles++;
+  }
+
+  bench_current = (BENCH_CYCLE_STRUCT){0};
+  bus_busy_counts[0] = 0;
+  bus_busy_counts[1] = 0;
+  cycle_start = now;
+  cycle_started = true;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the results.
+ *
+ * @note
+ *   Only available in a SAMPLE_BENCH build.
+ *
+ * @param[out] bench
+ *  Copy of the results
+ ******************************************************************************/
+void bench_get(BENCH_STRUCT *bench) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  *bench = bench_results;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Clears the results.
+ *
+ * @details
+ *   The cycle in progress is dropped, measuring starts again at the next
+ *   sample.
+ *
+ * @note
+ *   Only available in a SAMPLE_BENCH build.
+ ******************************************************************************/
+void bench_reset(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  bench_results = (BENCH_STRUCT){0};
+  bench_current = (BENCH_CYCLE_STRUCT){0};
+  bus_busy_counts[0] = 0;
+  bus_busy_counts[1] = 0;
+  cycle_started = false;
+  CORE_EXIT_CRITICAL();
+}
+
+#endif
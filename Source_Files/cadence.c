@@ -0,0 +1,166 @@
+/*****************************************************
+ * @file cadence.c
+ * @author Branson Camp
+ * @date 12/08/2022
+ * @brief Adapts the LETIMER0 sample period to how
+ * fast the readings change.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "cadence.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static uint32_t fast_period; // ms
+static uint32_t period; // ms, period LETIMER0 is running at
+static int32_t watch_hum; // centi-%RH, sampled fast while nearby
+static int32_t anchor_hum; // centi-%RH, reading the dead-band is centered on
+static int32_t anchor_temp; // centi-C, reading the dead-band is centered on
+static bool anchored; // False until the first reading
+static uint32_t stable_ms; // Time the readings have stayed inside the dead-band
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void cadence_set_period(uint32_t period_ms);
+static int32_t cadence_abs(int32_t value);
+
+/***************************************************************************//**
+ * @brief
+ *   Reprograms LETIMER0 if the period changes.
+ *
+ * @param[in] period_ms
+ *  New sample period in milliseconds
+ ******************************************************************************/
+static void cadence_set_period(uint32_t period_ms) {
+  if (period_ms != period) {
+      period = period_ms;
+      letimer_set_period(LETIMER0, period_ms);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the absolute value of a signed reading difference.
+ ******************************************************************************/
+static int32_t cadence_abs(int32_t value) {
+  return value < 0 ? -value : value;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes the adaptive sample cadence.
+ *
+ * @details
+ *   Sampling starts at the fast period until the readings have been seen to
+ *   settle.
+ *
+ * @note
+ *   Call this function after LETIMER0 has been opened with the fast period.
+ *
+ * @param[in] fast_ms
+ *  Sample period in milliseconds while the readings change
+ *
+ * @param[in] watch_humidity
+ *  Humidity in hundredths of a percent, such as an LED threshold, whose
+ *  crossing must not be missed. It is always sampled at the fast period.
+ ******************************************************************************/
+void cadence_open(uint32_t fast_ms, int32_t watch_humidity) {
+  EFM_ASSERT(fast_ms <= CADENCE_SLOW_MS);
+
+  fast_period = fast_ms;
+  period = fast_ms;
+  watch_hum = watch_humidity;
+  anchored = false;
+  stable_ms = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Picks the sample period from the newest reading.
+ *
+ * @details
+ *   Readings that stay within the dead-band around the anchor reading for
+ *   CADENCE_SETTLE_MS slow sampling down to CADENCE_SLOW_MS. A reading outside
+ *   the dead-band, or a humidity near the watched value, switches back to the
+ *   fast period at once and moves the anchor to that reading. Because the
+ *   dead-band is fixed, the rate of change that speeds sampling up scales with
+ *   the period it is measured over.
+ *
+ * @note
+ *   Call this function once per sample, from the scheduler.
+ *
+ * @param[in] humidity
+ *  Relative humidity in hundredths of a percent
+ *
+ * @param[in] temp
+ *  Temperature in hundredths of a degree Celcius
+ ******************************************************************************/
+void cadence_update(int32_t humidity, int32_t temp) {
+  bool moved = !anchored
+      || cadence_abs(humidity - anchor_hum) > CADENCE_HUM_DEADBAND
+      || cadence_abs(temp - anchor_temp) > CADENCE_TEMP_DEADBAND;
+  bool watched = cadence_abs(humidity - watch_hum) <= CADENCE_WATCH_BAND;
+
+  if (moved) {
+      anchor_hum = humidity;
+      anchor_temp = temp;
+      anchored = true;
+  }
+
+  if (moved || watched) {
+      stable_ms = 0;
+      cadence_set_period(fast_period);
+  } else {
+      stable_ms += period;
+      if (stable_ms >= CADENCE_SETTLE_MS) {
+          cadence_set_period(CADENCE_SLOW_MS);
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Changes the fast sample period.
+ *
+ * @details
+ *   Sampling switches to the new fast period at once and has to settle again
+ *   before it slows down.
+ *
+ * @note
+ *   Call this function from the scheduler, between samples.
+ *
+ * @param[in] fast_ms
+ *  Sample period in milliseconds while the readings change
+ ******************************************************************************/
+void cadence_set_fast_period(uint32_t fast_ms) {
+  EFM_ASSERT(fast_ms <= CADENCE_SLOW_MS);
+
+  fast_period = fast_ms;
+  stable_ms = 0;
+  cadence_set_period(fast_ms);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the sample period LETIMER0 is running at.
+ *
+ * @return
+ *   Sample period in milliseconds
+ ******************************************************************************/
+uint32_t cadence_get_period(void) {
+  return period;
+}
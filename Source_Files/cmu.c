@@ -36,7 +36,8 @@
  *
  * @details
  *   Opens the CMU (Clock Management Unit) peripheral. Sets the appropriate clock
- *   frequencies. Also routes the ULFRCO frequency to the LETIMER's clock branch.
+ *   frequencies. Also routes the ULFRCO frequency to the LETIMER's clock branch,
+ *   and the LFRCO to the LEUART's.
  *
  * @note
  *   This function should run once at the start of the program.
@@ -58,6 +59,11 @@ void cmu_open(void){
     // Route LF clock to LETIMER0 clock tree
     CMU_ClockSelectSet(cmuClock_LFA , cmuSelect_ULFRCO); // What clock tree does the LETIMER0 reside on?
 
+    // The LFRCO clocks LEUART0 through the LFB clock tree. It only runs down
+    // to EM2, which the telemetry link blocks while it sends.
+    CMU_OscillatorEnable(cmuOsc_LFRCO, true, true);
+    CMU_ClockSelectSet(cmuClock_LFB, cmuSelect_LFRCO);
+
     // Now, you must ensure that the global Low Frequency is enabled
     CMU_ClockEnable(cmuClock_CORELE, true); //This enumeration is found in the Lab 2 assignment
 
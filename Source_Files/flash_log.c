@@ -0,0 +1,176 @@
+/*****************************************************
+ * @file flash_log.c
+ * @author Branson Camp
+ * @date 12/17/2022
+ * @brief Keeps the sample blocks in internal flash in
+ * append-only pages that are rotated for wear levelling.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "flash_log.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define FLASH_LOG_PAGE(index) ((const FLASH_LOG_PAGE_STRUCT *)(uintptr_t)(FLASH_LOG_BASE + (index) * FLASH_PAGE_SIZE))
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static FLASH_LOG_PAGE_STRUCT page_buffer; // Page being filled, written once full
+static uint32_t buffered_blocks; // Blocks in page_buffer
+static uint32_t next_page; // Page written next, the oldest one once all are used
+static uint32_t next_sequence;
+static uint32_t written_pages; // Pages holding blocks, up to FLASH_LOG_PAGES
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static bool flash_log_page_valid(uint32_t index);
+static void flash_log_write_page(void);
+
+/***************************************************************************//**
+ * @brief
+ *   Checks whether a page of the log region has been written.
+ ******************************************************************************/
+static bool flash_log_page_valid(uint32_t index) {
+  return FLASH_LOG_PAGE(index)->magic == FLASH_LOG_MAGIC;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Erases the next page and writes the page buffer to it.
+ *
+ * @details
+ *   The blocks are written before the header, so a reset during the write
+ *   leaves a page without a header that the boot scan ignores.
+ *
+ * @note
+ *   Blocks the core for the erase and write, about 40 ms once per page.
+ ******************************************************************************/
+static void flash_log_write_page(void) {
+  uint32_t *page = (uint32_t *)FLASH_LOG_PAGE(next_page);
+  MSC_Status_TypeDef status;
+
+  page_buffer.magic = FLASH_LOG_MAGIC;
+  page_buffer.sequence = next_sequence++;
+
+  MSC_Init();
+  status = MSC_ErasePage(page);
+  EFM_ASSERT(status == mscReturnOk);
+  status = MSC_WriteWord(page + FLASH_LOG_HEADER_BYTES / 4, page_buffer.blocks, sizeof(page_buffer.blocks));
+  EFM_ASSERT(status == mscReturnOk);
+  status = MSC_WriteWord(page, &page_buffer, FLASH_LOG_HEADER_BYTES);
+  EFM_ASSERT(status == mscReturnOk);
+  MSC_Deinit();
+
+  next_page = (next_page + 1) % FLASH_LOG_PAGES;
+  if (written_pages < FLASH_LOG_PAGES) {
+      written_pages++;
+  }
+  buffered_blocks = 0;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Finds the head of the log left in flash.
+ *
+ * @details
+ *   Only the page headers are read. The written page with the highest
+ *   sequence is the head, and writing continues on the page after it, which
+ *   is the oldest one once the log has wrapped.
+ *
+ * @note
+ *   This function should be called once at startup, before
+ *   flash_log_append().
+ ******************************************************************************/
+void flash_log_open(void) {
+  _Static_assert(sizeof(FLASH_LOG_PAGE_STRUCT) <= FLASH_PAGE_SIZE, "A log page must fit a flash page");
+  _Static_assert(sizeof(SAMPLE_BLOCK) % 4 == 0, "Blocks are written in words");
+
+  bool found = false;
+  uint32_t head = 0;
+  uint32_t head_sequence = 0;
+
+  written_pages = 0;
+  for (uint32_t i = 0; i < FLASH_LOG_PAGES; i++) {
+      if (!flash_log_page_valid(i)) {
+          continue;
+      }
+      written_pages++;
+      uint32_t sequence = FLASH_LOG_PAGE(i)->sequence;
+      if (!found || (int32_t)(sequence - head_sequence) > 0) {
+          head = i;
+          head_sequence = sequence;
+          found = true;
+      }
+  }
+
+  next_page = found ? (head + 1) % FLASH_LOG_PAGES : 0;
+  next_sequence = found ? head_sequence + 1 : 0;
+  buffered_blocks = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Appends a sample block to the log.
+ *
+ * @details
+ *   Blocks are gathered in RAM and a page is erased and written only once
+ *   FLASH_LOG_PAGE_BLOCKS of them are buffered. Once every page is used, the
+ *   oldest page is overwritten.
+ *
+ * @note
+ *   This function runs in the main loop. The blocks still in RAM are lost
+ *   on a reset.
+ *
+ * @param[in] block
+ *  Block drained from the sample buffer
+ ******************************************************************************/
+void flash_log_append(const SAMPLE_BLOCK *block) {
+  page_buffer.blocks[buffered_blocks++] = *block;
+  if (buffered_blocks == FLASH_LOG_PAGE_BLOCKS) {
+      flash_log_write_page();
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Number of blocks stored in flash.
+ ******************************************************************************/
+uint32_t flash_log_count(void) {
+  return written_pages * FLASH_LOG_PAGE_BLOCKS;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a block back from flash.
+ *
+ * @param[in] index
+ *  Block to read, 0 is the oldest one in flash
+ *
+ * @param[out] block
+ *  Copy of the block
+ *
+ * @return
+ *   True if the block exists and its page is intact.
+ ******************************************************************************/
+bool flash_log_read(uint32_t index, SAMPLE_BLOCK *block) {
+  if (index >= flash_log_count()) {
+      return false;
+  }
+  uint32_t oldest = (next_page + FLASH_LOG_PAGES - written_pages) % FLASH_LOG_PAGES;
+  uint32_t page = (oldest + index / FLASH_LOG_PAGE_BLOCKS) % FLASH_LOG_PAGES;
+  if (!flash_log_page_valid(page)) {
+      return false;
+  }
+  memcpy(block, &FLASH_LOG_PAGE(page)->blocks[index % FLASH_LOG_PAGE_BLOCKS], sizeof(SAMPLE_BLOCK));
+  return true;
+}
@@ -0,0 +1,218 @@
+/*****************************************************
+ * @file fusion.c
+ * @author Branson Camp
+ * @date 12/15/2022
+ * @brief Combines the SI7021 and SHTC3 readings of a
+ * sample into one estimate and cross-checks them.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "fusion.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static SENSOR_READING_STRUCT readings[FUSION_NUM_SENSORS]; // Calibrated readings of this sample
+static uint32_t reading_times[FUSION_NUM_SENSORS];
+static uint32_t fresh; // Bit per sensor read in this sample
+static uint32_t sample_start; // LETIMER tick the sample started at
+static uint32_t agree_count; // Samples in a row the sensors agreed in
+static uint32_t single_count; // Single sensor samples since the last cross-check
+static uint32_t drift_count; // Samples the sensors disagreed in
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static int32_t fusion_blend(int32_t si7021, int32_t shtc3, int32_t shtc3_weight);
+static int32_t fusion_abs(int32_t value);
+
+/***************************************************************************//**
+ * @brief
+ *   Weighs two readings into one, rounding to nearest.
+ ******************************************************************************/
+static int32_t fusion_blend(int32_t si7021, int32_t shtc3, int32_t shtc3_weight) {
+  int32_t sum = si7021 * (FUSION_WEIGHT_SCALE - shtc3_weight) + shtc3 * shtc3_weight;
+  return (sum + (sum >= 0 ? FUSION_WEIGHT_SCALE / 2 : -FUSION_WEIGHT_SCALE / 2)) / FUSION_WEIGHT_SCALE;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the absolute value of a signed reading difference.
+ ******************************************************************************/
+static int32_t fusion_abs(int32_t value) {
+  return value < 0 ? -value : value;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes the fusion stage.
+ *
+ * @details
+ *   Both sensors are read until they have agreed for FUSION_AGREE_SAMPLES
+ *   samples in a row.
+ *
+ * @note
+ *   This function should be called once before the first sample.
+ ******************************************************************************/
+void fusion_open(void) {
+  fresh = 0;
+  agree_count = 0;
+  single_count = 0;
+  drift_count = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a new sample.
+ *
+ * @details
+ *   Only readings taken from now on are fused into the sample's estimate, so
+ *   a sensor that failed this sample does not contribute a stale reading.
+ *
+ * @note
+ *   This function should be called before the sample's reads are started.
+ *
+ * @param[in] now
+ *  LETIMER tick the sample starts at
+ ******************************************************************************/
+void fusion_begin(uint32_t now) {
+  fresh = 0;
+  sample_start = now;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Adds a sensor's reading to the sample.
+ *
+ * @details
+ *   The sensor's calibration offsets are applied. Readings taken before the
+ *   sample started are ignored.
+ *
+ * @param[in] sensor
+ *  Sensor the reading came from
+ *
+ * @param[in] reading
+ *  Decoded reading
+ *
+ * @param[in] timestamp
+ *  LETIMER tick the reading was taken at
+ ******************************************************************************/
+void fusion_add(FUSION_SENSOR_TypeDef sensor, const SENSOR_READING_STRUCT *reading, uint32_t timestamp) {
+  EFM_ASSERT(sensor < FUSION_NUM_SENSORS);
+  if ((int32_t)(timestamp - sample_start) < 0) {
+      return;
+  }
+
+  readings[sensor] = *reading;
+  if (sensor == FUSION_SI7021) {
+      readings[sensor].humidity += FUSION_SI7021_HUM_OFFSET;
+      readings[sensor].temp += FUSION_SI7021_TEMP_OFFSET;
+  } else {
+      readings[sensor].humidity += FUSION_SHTC3_HUM_OFFSET;
+      readings[sensor].temp += FUSION_SHTC3_TEMP_OFFSET;
+  }
+  reading_times[sensor] = timestamp;
+  fresh |= 1u << sensor;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Fuses the readings of the sample into one estimate.
+ *
+ * @details
+ *   With both readings, the estimate weighs each sensor by its accuracy and
+ *   the readings are cross-checked. A disagreement beyond the tolerance sets
+ *   the drift flag and goes back to reading both sensors. With one reading,
+ *   that reading is the estimate. A sample without an SHTC3 reading also
+ *   goes back to reading both, so a failed SHTC3 is covered by the SI7021.
+ *
+ * @note
+ *   This function should be called once all of the sample's reads are done.
+ *
+ * @param[out] estimate
+ *  Fused estimate, left untouched if no sensor was read
+ *
+ * @return
+ *   True if the estimate was updated.
+ ******************************************************************************/
+bool fusion_update(FUSION_ESTIMATE_STRUCT *estimate) {
+  const SENSOR_READING_STRUCT *si7021 = &readings[FUSION_SI7021];
+  const SENSOR_READING_STRUCT *shtc3 = &readings[FUSION_SHTC3];
+  uint32_t both = (1u << FUSION_SI7021) | (1u << FUSION_SHTC3);
+
+  if (fresh == both) {
+      bool drift = fusion_abs(si7021->humidity - shtc3->humidity) > FUSION_HUM_TOLERANCE
+          || fusion_abs(si7021->temp - shtc3->temp) > FUSION_TEMP_TOLERANCE;
+      if (drift) {
+          drift_count++;
+          agree_count = 0;
+      } else if (agree_count < FUSION_AGREE_SAMPLES) {
+          agree_count++;
+      }
+      single_count = 0;
+
+      estimate->humidity = fusion_blend(si7021->humidity, shtc3->humidity, FUSION_SHTC3_HUM_WEIGHT);
+      estimate->temp = fusion_blend(si7021->temp, shtc3->temp, FUSION_SHTC3_TEMP_WEIGHT);
+      uint32_t t0 = reading_times[FUSION_SI7021];
+      uint32_t t1 = reading_times[FUSION_SHTC3];
+      estimate->timestamp = (int32_t)(t1 - t0) > 0 ? t1 : t0;
+      estimate->drift = drift;
+  } else if (fresh) {
+      FUSION_SENSOR_TypeDef sensor = (fresh & (1u << FUSION_SHTC3)) ? FUSION_SHTC3 : FUSION_SI7021;
+      if (sensor == FUSION_SI7021) {
+          agree_count = 0; // The SHTC3 failed, fall back to reading both
+      }
+      single_count++;
+      estimate->humidity = readings[sensor].humidity;
+      estimate->temp = readings[sensor].temp;
+      estimate->timestamp = reading_times[sensor];
+      estimate->drift = false;
+  } else {
+      agree_count = 0; // Neither was read, the next sample reads both
+      return false;
+  }
+
+  estimate->sources = fresh;
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Tells whether a sensor should be read in the next sample.
+ *
+ * @details
+ *   Once the sensors have agreed for FUSION_AGREE_SAMPLES samples, only the
+ *   SHTC3, the more accurate of the two, is read. Every
+ *   FUSION_CROSSCHECK_SAMPLES samples both are read again to check that they
+ *   still agree.
+ *
+ * @param[in] sensor
+ *  Sensor to ask about
+ *
+ * @return
+ *   True if the sensor should be read.
+ ******************************************************************************/
+bool fusion_wants(FUSION_SENSOR_TypeDef sensor) {
+  bool single = agree_count >= FUSION_AGREE_SAMPLES && single_count < FUSION_CROSSCHECK_SAMPLES;
+  return sensor == FUSION_SHTC3 || !single;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of samples the sensors disagreed in.
+ ******************************************************************************/
+uint32_t fusion_drift_count(void) {
+  return drift_count;
+}
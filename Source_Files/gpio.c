@@ -68,9 +68,9 @@ void gpio_open(void){
   NVIC_EnableIRQ(GPIO_ODD_IRQn);
   NVIC_EnableIRQ(GPIO_EVEN_IRQn);
 
-  // Configure Sensor Enable Pin
+  // Configure Sensor Enable Pin, switched by sensor_power
   GPIO_DriveStrengthSet(SI7021_SENSOR_EN_PORT, gpioDriveStrengthWeakAlternateWeak);
-  GPIO_PinModeSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN, gpioModePushPull, 1);
+  GPIO_PinModeSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN, gpioModePushPull, 0);
 
   // Configure SI7021 SDA SCL
   GPIO_PinModeSet(SI7021_SCL_PORT, SI7021_SCL_PIN,  SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
@@ -79,6 +79,9 @@ void gpio_open(void){
   // Configure SI7021 SDA SCL
   GPIO_PinModeSet(SHTC3_SCL_PORT, SHTC3_SCL_PIN,  SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
   GPIO_PinModeSet(SHTC3_SDA_PORT, SHTC3_SDA_PIN, SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
+
+  // Configure LEUART0 TX
+  GPIO_PinModeSet(LEUART0_TX_PORT, LEUART0_TX_PIN, LEUART0_TX_CONFIG, LEUART0_TX_DEFAULT);
 }
 
 /***************************************************************************//**
@@ -94,6 +97,7 @@ void gpio_open(void){
  *
  ******************************************************************************/
 void GPIO_ODD_IRQHandler(void) {
+  BENCH_ISR();
   uint32_t int_flag = GPIO->IF & GPIO->IEN;
   GPIO->IFC = int_flag; // Clear IF register
   add_scheduled_event(gpio_odd_irq_cb);
@@ -112,6 +116,7 @@ void GPIO_ODD_IRQHandler(void) {
  *
  ******************************************************************************/
 void GPIO_EVEN_IRQHandler(void) {
+  BENCH_ISR();
   uint32_t int_flag = GPIO->IF & GPIO->IEN;
   GPIO->IFC = int_flag; // Clear IF register
   add_scheduled_event(gpio_even_irq_cb);
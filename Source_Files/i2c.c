@@ -26,16 +26,292 @@ typedef struct {
   uint32_t finished_callback; // event cb after i2c is finished
   I2C_COMM_METHOD_TypeDef comm_method; // read or write
   bool busy; // Is the state machine busy?
-  uint32_t* data;
+  uint8_t* data; // Next byte to send or receive
   uint32_t byte_counter; // Counts down from num_bytes
 
   uint32_t num_register_bytes;
   uint32_t register_byte_counter;
+  I2C_START_STRUCT* next; // Chained transfer to start when this one stops
+  I2C_START_STRUCT* active; // Transfer on the bus, restarted on recovery
+  I2C_STATUS_TypeDef* status; // Where the result of the transfer goes
+
+  // Error recovery
+  uint32_t nack_count; // Read header NACKs of the transfer
+  uint32_t retries; // Restarts of the transfer
+  uint32_t launches; // Counts up on every launch
+  uint32_t checked_launches; // launches at the previous timeout check
+  I2C_ERROR_STRUCT errors;
+
+  // LDMA transfer of the data bytes
+  uint32_t ldma_channel;
+  bool ldma_active; // Data bytes are being moved by the LDMA
+  LDMA_Descriptor_t ldma_desc[2]; // Read by the LDMA while the transfer runs
+  uint32_t ldma_ctrl; // CTRL without AUTOACK, written by the LDMA itself
+
+  // Pending transfers, queue[queue_head] is the one on the bus while busy
+  I2C_START_STRUCT queue[I2C_QUEUE_SIZE];
+  uint32_t queue_head; // Oldest queued transfer
+  uint32_t queue_count; // Number of queued transfers, including the active one
 
 } I2C_STATE_MACHINE_STRUCT;
 
-static I2C_STATE_MACHINE_STRUCT i2c0_state_machine;
-static I2C_STATE_MACHINE_STRUCT i2c1_state_machine;
+static I2C_STATE_MACHINE_STRUCT i2c_state_machines[I2C_NUM_BUSES]; // Indexed by which_i2c
+static uint32_t i2c_timeout_cb; // 0 when no timeout checks are run
+static SWTIMER_STRUCT i2c_timeout_timer; // Periodic while a bus is busy
+
+static void i2c_ldma_done(uint32_t channel);
+static void i2c_launch(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx, I2C_START_STRUCT *i2c_start);
+static void i2c_bus_reset(I2C_TypeDef *i2cx);
+
+/***************************************************************************//**
+ * @brief
+ *   Sends the next register (command) byte.
+ *
+ * @details
+ *   Register bytes are sent from most significant to least significant byte.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_send_register_byte(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  i2c_sm->register_byte_counter--;
+  i2cx->TXDATA = (i2c_sm->register_address >> (8 * i2c_sm->register_byte_counter)) & 0xFF;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Sends the next data byte, or the stop condition once all are sent.
+ *
+ * @details
+ *   Data bytes are sent straight from the caller's buffer.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_send_data_byte(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  if (i2c_sm->byte_counter > 0) {
+      i2cx->TXDATA = *i2c_sm->data++; // Write the byte
+      i2c_sm->byte_counter--; // Decrement byte counter
+  } else {
+      // Writing is done. Send Stop Command.
+      i2cx->CMD = I2C_CMD_STOP;
+      i2c_sm->current_state = send_stop;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Receives the data bytes by LDMA.
+ *
+ * @details
+ *   The I2C acknowledges every byte by itself while the LDMA drains RXDATA
+ *   into the caller's buffer, so no interrupt is taken per byte. The LDMA
+ *   moves all bytes but the last. The last byte is left to the RXDATAV
+ *   interrupt, which NACKs it and sends the stop condition.
+ *
+ * @note
+ *   AUTOACK must be off before the last byte is received, or the I2C ACKs it
+ *   and the slave keeps driving SDA. The done interrupt can run too late for
+ *   that, so a second descriptor has the LDMA itself write CTRL back without
+ *   AUTOACK straight after it takes the second to last byte. The last byte
+ *   then waits on the bus for the NACK from the RXDATAV interrupt.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_ldma_read(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  uint32_t ldma_bytes = i2c_sm->byte_counter - 1;
+  LDMA_TransferCfg_t ldma_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(I2C_BUS_LDMA_RX(i2c_sm->which_i2c));
+  LDMA_Descriptor_t ldma_desc[2] = {
+      LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(&i2cx->RXDATA, i2c_sm->data, ldma_bytes, 1),
+      LDMA_DESCRIPTOR_SINGLE_M2M_WORD(&i2c_sm->ldma_ctrl, &i2cx->CTRL, 1)
+  };
+  i2c_sm->ldma_desc[0] = ldma_desc[0];
+  i2c_sm->ldma_desc[1] = ldma_desc[1];
+  i2c_sm->ldma_ctrl = i2cx->CTRL & ~I2C_CTRL_AUTOACK;
+
+  // The state machine resumes at the last byte
+  i2c_sm->data += ldma_bytes;
+  i2c_sm->byte_counter = 1;
+  i2c_sm->ldma_active = true;
+
+  i2cx->IEN &= ~I2C_IEN_RXDATAV;
+  i2cx->CTRL |= I2C_CTRL_AUTOACK;
+  ldma_start(i2c_sm->ldma_channel, &ldma_cfg, i2c_sm->ldma_desc, i2c_ldma_done);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts sending the data bytes of a write.
+ *
+ * @details
+ *   The data bytes are sent a byte per ACK. The writes in this design are a
+ *   byte or two, where the LDMA setup would cost more than it saves.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_start_write_data(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  i2c_sm->current_state = write_data;
+  i2c_send_data_byte(i2c_sm, i2cx);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Hands the bus back from the LDMA to the interrupt driven state machine.
+ *
+ * @details
+ *   Stops the LDMA channel if it is still running and turns the automatic
+ *   ACK off again.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_ldma_release(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  if (!i2c_sm->ldma_active) {
+      return;
+  }
+  ldma_stop(i2c_sm->ldma_channel);
+  i2c_sm->ldma_active = false;
+  i2cx->CTRL &= ~I2C_CTRL_AUTOACK;
+  i2cx->IEN |= I2C_IEN_RXDATAV;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Retires the transfer in the queue's head slot and starts the next one.
+ *
+ * @details
+ *   Once the queue is empty, the state machine's busy lock and sleep block
+ *   are released.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_retire(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  i2c_sm->queue_head = (i2c_sm->queue_head + 1) % I2C_QUEUE_SIZE;
+  i2c_sm->queue_count--;
+
+  if (i2c_sm->queue_count > 0) {
+      i2c_launch(i2c_sm, i2cx, &i2c_sm->queue[i2c_sm->queue_head]);
+  } else {
+      i2c_sm->busy = false;
+      sleep_unblock_mode(I2C_EM, I2C_SLEEP_CALLER(i2c_sm->which_i2c));
+      BENCH_BUS(i2c_sm->which_i2c, false);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Recovers the bus after a failed transfer.
+ *
+ * @details
+ *   Resets the bus and starts the transfer over, up to I2C_TRANSFER_RETRIES
+ *   times. After that the transfer and the ones chained to it fail: their
+ *   status is set, their events are scheduled so the caller is not left
+ *   waiting, and the next queued transfer is started.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module. It is
+ *   called with interrupts off, from the I2C interrupt or the timeout check.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ * @param[in] status
+ *  Why the transfer failed
+ *
+ ******************************************************************************/
+static void i2c_recover(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx, I2C_STATUS_TypeDef status) {
+  i2c_ldma_release(i2c_sm, i2cx);
+  i2c_bus_reset(i2cx);
+  i2c_sm->errors.resets++;
+
+  if (!i2c_sm->busy) {
+      return; // Stray interrupt on an idle bus
+  }
+
+  uint32_t retries = i2c_sm->retries + 1;
+  if (retries <= I2C_TRANSFER_RETRIES) {
+      i2c_launch(i2c_sm, i2cx, i2c_sm->active);
+      i2c_sm->retries = retries;
+      return;
+  }
+
+  i2c_sm->errors.failures++;
+  i2c_sm->current_state = end_process;
+  for (I2C_START_STRUCT *failed = i2c_sm->active; failed; failed = failed->next) {
+      if (failed->status) {
+          *failed->status = status;
+      }
+      add_scheduled_event(failed->finished_callback);
+  }
+  i2c_retire(i2c_sm, i2cx);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Recovers from an interrupt the state machine did not expect.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_bad_state(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
+  i2c_sm->errors.bus_errors++;
+  i2c_recover(i2c_sm, i2cx, I2C_STATUS_BUS_ERROR);
+}
 
 /***************************************************************************//**
  * @brief
@@ -59,92 +335,41 @@ static I2C_STATE_MACHINE_STRUCT i2c1_state_machine;
 static void i2c_ack_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
   switch (i2c_sm->current_state) {
     case initialize:
-      i2c_sm->current_state = send_register;
       if (i2c_sm->register_byte_counter > 0) {
-          // Sends data from most significant to least significant bytes
-          uint32_t data_copy = i2c_sm->register_address;
-
-          // Which byte to send: 0 = LSB, max = MSB
-          uint32_t which_byte = i2c_sm->register_byte_counter - 1;
-          uint32_t byte_mask = 0xFF << (8 * which_byte); // Masks the correct byte
-          data_copy &= byte_mask;
-          data_copy >>= 8 * which_byte; // Consolidate to one byte for writing
-          i2cx->TXDATA = data_copy; // Write the byte
-          i2c_sm->register_byte_counter--; // Decrement byte counter
-
-          if (i2c_sm->register_byte_counter > 0) {
-              i2c_sm->current_state = initialize;
-          }
+          i2c_sm->current_state = send_register;
+          i2c_send_register_byte(i2c_sm, i2cx);
       } else {
-          // Sends data from most significant to least significant bytes
-          uint32_t data_copy = *i2c_sm->data;
-
-          // Which byte to send: 0 = LSB, max = MSB
-          uint32_t which_byte = i2c_sm->byte_counter - 1;
-          uint32_t byte_mask = 0xFF << (8 * which_byte); // Masks the correct byte
-          data_copy &= byte_mask;
-          data_copy >>= 8 * which_byte; // Consolidate to one byte for writing
-          i2cx->TXDATA = data_copy; // Write the byte
-          i2c_sm->byte_counter--; // Decrement byte counter
+          EFM_ASSERT(i2c_sm->comm_method == I2C_WRITE);
+          i2c_start_write_data(i2c_sm, i2cx);
       }
       break;
     case send_register:
-      if (i2c_sm->comm_method == I2C_READ) {
-        i2c_sm->current_state = request_read;
-        i2cx->CMD = I2C_CMD_START; // Repeated Start
-        i2cx->TXDATA = (i2c_sm->device_address << 1) | I2C_R; // Device Addr + R
+      if (i2c_sm->register_byte_counter > 0) {
+          i2c_send_register_byte(i2c_sm, i2cx);
+      } else if (i2c_sm->comm_method == I2C_READ) {
+          i2c_sm->current_state = request_read;
+          i2cx->CMD = I2C_CMD_START; // Repeated Start
+          i2cx->TXDATA = (i2c_sm->device_address << 1) | I2C_R; // Device Addr + R
       } else {
-        i2c_sm->current_state = write_data;
-        // Sends data from most significant to least significant bytes
-        uint32_t data_copy = *i2c_sm->data;
-
-        // Which byte to send: 0 = LSB, max = MSB
-        uint32_t which_byte = i2c_sm->byte_counter - 1;
-        uint32_t byte_mask = 0xFF << (8 * which_byte); // Masks the correct byte
-        data_copy &= byte_mask;
-        data_copy >>= 8 * which_byte; // Consolidate to one byte for writing
-        i2cx->TXDATA = data_copy; // Write the byte
-        i2c_sm->byte_counter--; // Decrement byte counter
-
+          i2c_start_write_data(i2c_sm, i2cx);
       }
       break;
     case request_read:
       EFM_ASSERT(i2c_sm->comm_method == I2C_READ);
       i2c_sm->current_state = read_data;
-        //i2cx->CMD = I2C_CMD_STOP;
-        //i2c_sm->current_state = send_stop;
-      break;
-    case read_data:
-      EFM_ASSERT(false); // Not in our design ladder
+      if (i2c_sm->byte_counter >= I2C_LDMA_MIN_BYTES) {
+          i2c_ldma_read(i2c_sm, i2cx);
+      }
       break;
     case write_data:
       EFM_ASSERT(i2c_sm->comm_method == I2C_WRITE);
-
-      if (i2c_sm->byte_counter > 0) {
-        // Sends data from most significant to least significant bytes
-        uint32_t data_copy = *i2c_sm->data;
-
-        // Which byte to send: 0 = LSB, max = MSB
-        uint32_t which_byte = i2c_sm->byte_counter - 1;
-        uint32_t byte_mask = 0xFF << (8 * which_byte); // Masks the correct byte
-        data_copy &= byte_mask;
-        data_copy >>= 8 * which_byte; // Consolidate to one byte for writing
-        i2cx->TXDATA = data_copy; // Write the byte
-        i2c_sm->byte_counter--; // Decrement byte counter
-      } else {
-        // Writing is done. Send Stop Command.
-        i2cx->CMD = I2C_CMD_STOP;
-        i2c_sm->current_state = send_stop;
-      }
+      i2c_send_data_byte(i2c_sm, i2cx);
       break;
+    case read_data:
     case send_stop:
-      EFM_ASSERT(false); // Not in our design ladder
-      break;
     case end_process:
-      EFM_ASSERT(false); // Not in our design ladder
-      break;
     default:
-      EFM_ASSERT(false); // Not in our design ladder
+      i2c_bad_state(i2c_sm, i2cx); // Not in our design ladder
       break;
   }
 }
@@ -154,9 +379,10 @@ static void i2c_ack_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
  *   Service routine for when an NACK is received from a slave
  *
  * @details
- *   This function is called when an NACK is received from a slave. It resends
- *   the previous command until an ACK is reveived.
- *
+ *   This function is called when an NACK is received from a slave. A NACKed
+ *   read header means the slave is still converting, so it is resent up to
+ *   I2C_NACK_RETRIES times. Any other NACK, or a slave that stays busy, fails
+ *   the transfer over to i2c_recover().
  *
  * @note
  *   This function should not be called from outside the I2C module.
@@ -169,9 +395,70 @@ static void i2c_ack_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
  *
  ******************************************************************************/
 static void i2c_nack_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
-  EFM_ASSERT(i2c_sm->current_state == request_read);
-  i2cx->CMD = I2C_CMD_START; // Repeated Start
-  i2cx->TXDATA = (i2c_sm->device_address << 1) | I2C_R; // Device Addr + R
+  if (i2c_sm->current_state == request_read && i2c_sm->nack_count < I2C_NACK_RETRIES) {
+      i2c_sm->nack_count++;
+      i2cx->CMD = I2C_CMD_START; // Repeated Start
+      i2cx->TXDATA = (i2c_sm->device_address << 1) | I2C_R; // Device Addr + R
+      return;
+  }
+
+  i2c_sm->errors.nacks++;
+  i2c_recover(i2c_sm, i2cx, I2C_STATUS_NACK);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Loads a queued transfer into the state machine and starts it.
+ *
+ * @details
+ *   Copies the transfer description into the state machine and sends the
+ *   start condition with the device address. Reads without register bytes
+ *   start with the read header.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module. It is
+ *   called from i2c_start() when the bus is idle, from the MSTOP interrupt
+ *   when more transfers are queued, and from i2c_recover() to retry.
+ *
+ * @param[in] i2c_sm
+ *  I2C State Machine struct
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ * @param[in] i2c_start
+ *  Queued transfer to be started
+ *
+ ******************************************************************************/
+static void i2c_launch(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx, I2C_START_STRUCT *i2c_start) {
+  EFM_ASSERT((i2cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+
+  i2c_sm->current_state = initialize;
+  i2c_sm->which_i2c = i2c_start->which_i2c;
+  i2c_sm->device_address = i2c_start->device_address;
+  i2c_sm->register_address = i2c_start->register_address;
+  i2c_sm->num_bytes = i2c_start->num_bytes;
+  i2c_sm->finished_callback = i2c_start->finished_callback;
+  i2c_sm->comm_method = i2c_start->comm_method;
+  i2c_sm->data = i2c_start->data;
+  i2c_sm->byte_counter = i2c_start->num_bytes;
+  i2c_sm->num_register_bytes = i2c_start->num_register_bytes;
+  i2c_sm->register_byte_counter = i2c_start->num_register_bytes;
+  i2c_sm->next = i2c_start->next;
+  i2c_sm->active = i2c_start;
+  i2c_sm->status = i2c_start->status;
+  i2c_sm->nack_count = 0;
+  i2c_sm->retries = 0;
+  i2c_sm->launches++;
+
+  i2cx->CMD = I2C_CMD_START; // Start
+  if (i2c_start->comm_method == I2C_READ && i2c_start->num_register_bytes == 0) {
+      // Nothing to write, go straight to the read header
+      i2c_sm->current_state = request_read;
+      i2cx->TXDATA = (i2c_start->device_address << 1) | I2C_R; // Give device address + R
+  } else {
+      i2cx->TXDATA = (i2c_start->device_address << 1) | I2C_W; // Give device address + W
+  }
 }
 
 /***************************************************************************//**
@@ -179,8 +466,10 @@ static void i2c_nack_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
  *   Service routine for when an STOP is executed on the bus
  *
  * @details
- *   This function takes care of freeing the state machine's busy lock
- *   and scheduling the event that the operation is complete
+ *   This function schedules the event that the operation is complete and
+ *   starts the transfer chained to it, if any. Otherwise the queue slot is
+ *   retired and the next queued transfer is started. Once the queue is empty,
+ *   the state machine's busy lock and sleep block are released.
  *
  * @note
  *   This function should not be called from outside the I2C module.
@@ -193,11 +482,27 @@ static void i2c_nack_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
  *
  ******************************************************************************/
 static void i2c_stop_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
-  EFM_ASSERT(i2c_sm->current_state == send_stop);
+  if (i2c_sm->current_state != send_stop) {
+      i2c_bad_state(i2c_sm, i2cx); // Stop we did not ask for
+      return;
+  }
   i2c_sm->current_state = end_process;
+  if (i2c_sm->status) {
+      *i2c_sm->status = I2C_STATUS_OK;
+  }
   add_scheduled_event(i2c_sm->finished_callback);
-  i2c_sm->busy = false;
-  sleep_unblock_mode(I2C_EM);
+
+  // Hand the bus back to the interrupt driven state machine
+  i2c_ldma_release(i2c_sm, i2cx);
+
+  if (i2c_sm->next) {
+      // Chained transfers share the queue slot
+      i2c_launch(i2c_sm, i2cx, i2c_sm->next);
+      return;
+  }
+
+  // Retire the finished transfer
+  i2c_retire(i2c_sm, i2cx);
 }
 
 /***************************************************************************//**
@@ -205,8 +510,9 @@ static void i2c_stop_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
  *   Service routine for when RX data is received from the slave.
  *
  * @details
- *   This function is called when data is recieved from a slave. Data is
- *   allocated one byte at a time.
+ *   This function is called when data is recieved from a slave. Each byte is
+ *   written into the caller's buffer. The last byte is NACKed and followed by
+ *   a stop condition. Data outside of a read recovers the bus.
  *
  * @note
  *   This function should not be called from outside the I2C module.
@@ -219,11 +525,13 @@ static void i2c_stop_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
  *
  ******************************************************************************/
 static void i2c_rxdatav_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx) {
-  uint32_t rxdata = i2cx->RXDATA;
+  if (i2c_sm->current_state != read_data || i2c_sm->byte_counter == 0) {
+      i2c_bad_state(i2c_sm, i2cx);
+      return;
+  }
+  *i2c_sm->data++ = i2cx->RXDATA; // Store straight into the caller's buffer
+  i2c_sm->byte_counter--;
   if (i2c_sm->byte_counter > 0) {
-    *(i2c_sm->data) = *(i2c_sm->data) << 8;
-    *(i2c_sm->data) |= rxdata;
-    i2c_sm->byte_counter--;
     i2cx->CMD = I2C_CMD_ACK;
   } else {
     i2cx->CMD = I2C_CMD_NACK;
@@ -232,12 +540,46 @@ static void i2c_rxdatav_sm(I2C_STATE_MACHINE_STRUCT *i2c_sm, I2C_TypeDef *i2cx)
   }
 }
 
+/***************************************************************************//**
+ * @brief
+ *   Clocks SCL by hand to free a slave that holds SDA low.
+ *
+ * @details
+ *   A slave reset or cut off in the middle of a byte keeps driving SDA until
+ *   it has clocked out the rest of that byte. SCL is taken from the I2C and
+ *   pulsed I2C_CLOCKOUT_PULSES times through the GPIO, which finishes any
+ *   byte, then handed back.
+ *
+ * @note
+ *   This function should not be called from outside the I2C module. It busy
+ *   waits for the pulses, a few hundred us.
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ ******************************************************************************/
+static void i2c_clock_out(I2C_TypeDef *i2cx) {
+  bool which = I2C_BUS_WHICH(i2cx);
+
+  i2cx->ROUTEPEN &= ~I2C_ROUTEPEN_SCLPEN; // GPIO drives SCL
+  for (uint32_t pulse = 0; pulse < I2C_CLOCKOUT_PULSES; pulse++) {
+      GPIO_PinOutClear(I2C_BUS_SCL_PORT(which), I2C_BUS_SCL_PIN(which));
+      for (volatile uint32_t i = 0; i < I2C_CLOCKOUT_LOOPS; i++);
+      GPIO_PinOutSet(I2C_BUS_SCL_PORT(which), I2C_BUS_SCL_PIN(which));
+      for (volatile uint32_t i = 0; i < I2C_CLOCKOUT_LOOPS; i++);
+  }
+  i2cx->ROUTEPEN |= I2C_ROUTEPEN_SCLPEN;
+}
+
 /***************************************************************************//**
  * @brief
  *   Resets the I2C bus.
  *
  * @details
- *   Performs an I2C bus reset. Sends stop and abort commands.
+ *   Performs an I2C bus reset. Sends stop and abort commands. A stop that
+ *   does not show up within I2C_RESET_POLLS polls means a slave holds the
+ *   bus. The I2C is then aborted and SCL clocked out by hand, and the reset
+ *   is counted as failed in the bus's error counters.
  *
  * @note
  *   Call this function to reset the bus.
@@ -256,8 +598,16 @@ static void i2c_bus_reset(I2C_TypeDef *i2cx) {
   i2cx->CMD = I2C_CMD_START;
   i2cx->CMD = I2C_CMD_STOP;
 
-  // Stall until MSTOP is set
-  while(!(i2cx->IF & I2C_IF_MSTOP));
+  // Stall until MSTOP is set, or give up on a held bus
+  uint32_t polls = 0;
+  while (!(I2C_IntGet(i2cx) & I2C_IF_MSTOP) && polls < I2C_RESET_POLLS) {
+      polls++;
+  }
+  if (!(I2C_IntGet(i2cx) & I2C_IF_MSTOP)) {
+      i2cx->CMD = I2C_CMD_ABORT;
+      i2c_clock_out(i2cx);
+      i2c_state_machines[I2C_BUS_WHICH(i2cx)].errors.failed_resets++;
+  }
   i2cx->IFC = ~0; // Clear all interrupts
 
   i2cx->CMD = I2C_CMD_ABORT; // Set abort bit
@@ -266,53 +616,155 @@ static void i2c_bus_reset(I2C_TypeDef *i2cx) {
 
 /***************************************************************************//**
  * @brief
- *   Starts the i2c process and sends the first commands to the slave.
+ *   Brings an idle bus back into a known state.
+ *
+ * @details
+ *   While its pins are disabled, the I2C cannot tell whether the bus is free.
+ *   A bus reset after the pins have been enabled again lets the next transfer
+ *   start.
+ *
+ * @note
+ *   No transfer may be queued on the bus.
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ ******************************************************************************/
+void i2c_reset(I2C_TypeDef *i2cx) {
+  EFM_ASSERT(!i2c_state_machines[I2C_BUS_WHICH(i2cx)].busy);
+  i2c_bus_reset(i2cx);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Enables the transaction timeout of both buses.
  *
  * @details
- *   Starts the read or write operation and prepares to receive an ACK.
+ *   While a bus is busy, a check runs every I2C_TIMEOUT_MS on a periodic
+ *   software timer. A transfer that is still on the bus from the
+ *   previous check is reset and retried, so a stuck bus cannot keep the
+ *   device awake.
  *
  * @note
- *   This function should be called after this module is initialized with i2c_open
+ *   The handler of timeout_cb must call i2c_timeout_check(). Call this
+ *   function after swtimer_open().
+ *
+ * @param[in] timeout_cb
+ *  Callback code scheduled for each timeout check
+ ******************************************************************************/
+void i2c_timeout_open(uint32_t timeout_cb) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  i2c_timeout_cb = timeout_cb;
+  swtimer_cancel(&i2c_timeout_timer);
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Checks both buses for a stalled transfer.
+ *
+ * @details
+ *   A bus that has not launched a transfer since the previous check has had
+ *   the same one on the bus for at least I2C_TIMEOUT_MS. It is reset and the
+ *   transfer retried or failed. The timer is stopped once both buses are idle.
+ *
+ * @note
+ *   This function should be called from the handler of the timeout callback
+ *   passed to i2c_timeout_open().
+ ******************************************************************************/
+void i2c_timeout_check(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+
+  bool busy = false;
+
+  for (int i = 0; i < I2C_NUM_BUSES; i++) {
+      I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_state_machines[i];
+      if (i2c_sm->busy && i2c_sm->launches == i2c_sm->checked_launches) {
+          i2c_sm->errors.timeouts++;
+          i2c_recover(i2c_sm, I2C_BUS(i), I2C_STATUS_TIMEOUT);
+      }
+      i2c_sm->checked_launches = i2c_sm->launches;
+      busy |= i2c_sm->busy;
+  }
+
+  if (!busy) {
+      swtimer_cancel(&i2c_timeout_timer);
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reads the error counters of a bus.
+ *
+ * @details
+ *   The counters run from i2c_open() on and show how often the bus had to be
+ *   recovered and why.
+ *
+ * @param[in] i2cx
+ *  I2C peripheral struct
+ *
+ * @param[out] errors
+ *  Copy of the bus's error counters
+ ******************************************************************************/
+void i2c_get_errors(I2C_TypeDef *i2cx, I2C_ERROR_STRUCT *errors) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  *errors = i2c_state_machines[I2C_BUS_WHICH(i2cx)].errors;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Queues an i2c transfer and starts it if the bus is idle.
+ *
+ * @details
+ *   Copies the transfer into the bus's queue and returns immediately. If no
+ *   transfer is in progress, the read or write operation is started and the
+ *   state machine prepares to receive an ACK. Otherwise the transfer is started
+ *   from the MSTOP interrupt once the transfers ahead of it have finished.
+ *
+ * @note
+ *   This function should be called after this module is initialized with i2c_open.
+ *   The data buffer is not copied and must stay valid until the
+ *   finished_callback event is scheduled. Transfers chained through next are
+ *   not copied either and run back to back in the same queue slot. A failed
+ *   transfer still schedules its event, with the reason in its status. The
+ *   transfers chained after it are not run and fail the same way.
  *
  * @param[in] i2c_start
  *  I2C Start struct which includes necessary information for the I2C
  *  state machine such as device address, register address, data bytes, etc.
  ******************************************************************************/
 void i2c_start(I2C_START_STRUCT *i2c_start) {
-  I2C_STATE_MACHINE_STRUCT *i2cx_state_machine;
-  I2C_TypeDef *i2cx;
-  if (i2c_start->which_i2c) {
-      i2cx_state_machine = &i2c1_state_machine;
-      i2cx = I2C1;
-  } else {
-      i2cx_state_machine = &i2c0_state_machine;
-      i2cx = I2C0;
-  }
+  I2C_STATE_MACHINE_STRUCT *i2cx_state_machine = &i2c_state_machines[i2c_start->which_i2c];
+  I2C_TypeDef *i2cx = I2C_BUS(i2c_start->which_i2c);
 
-  // Wait till i2c is not busy
-  while(i2cx_state_machine->busy);
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
 
-  EFM_ASSERT((i2cx->STATE & _I2C_STATE_STATE_MASK) == I2C_STATE_STATE_IDLE);
+  EFM_ASSERT(i2cx_state_machine->queue_count < I2C_QUEUE_SIZE);
 
-  // Block appropriate sleep mode
-  sleep_block_mode(I2C_EM);
-
-  // Fill state machine struct
-  i2cx_state_machine->busy = true;
-  i2cx_state_machine->current_state = initialize;
-  i2cx_state_machine->which_i2c = i2c_start->which_i2c;
-  i2cx_state_machine->device_address = i2c_start->device_address;
-  i2cx_state_machine->register_address = i2c_start->register_address;
-  i2cx_state_machine->num_bytes = i2c_start->num_bytes;
-  i2cx_state_machine->finished_callback = i2c_start->finished_callback;
-  i2cx_state_machine->comm_method = i2c_start->comm_method;
-  i2cx_state_machine->data = i2c_start->data;
-  i2cx_state_machine->byte_counter = i2c_start->num_bytes;
-  i2cx_state_machine->num_register_bytes = i2c_start->num_register_bytes;
-  i2cx_state_machine->register_byte_counter = i2c_start->num_register_bytes;
+  // Copy the transfer into the next free slot
+  uint32_t slot = (i2cx_state_machine->queue_head + i2cx_state_machine->queue_count) % I2C_QUEUE_SIZE;
+  I2C_START_STRUCT *queued = &i2cx_state_machine->queue[slot];
+  *queued = *i2c_start;
+  i2cx_state_machine->queue_count++;
 
-  i2cx->CMD = I2C_CMD_START; // Start
-  i2cx->TXDATA = (i2c_start->device_address << 1) | I2C_W; // Give device address + W
+  if (!i2cx_state_machine->busy) {
+      // Block appropriate sleep mode until the queue drains
+      sleep_block_mode(I2C_EM, I2C_SLEEP_CALLER(i2c_start->which_i2c));
+      i2cx_state_machine->busy = true;
+      BENCH_BUS(i2c_start->which_i2c, true);
+      i2c_launch(i2cx_state_machine, i2cx, queued);
+
+      if (i2c_timeout_cb && !swtimer_active(&i2c_timeout_timer)) {
+          swtimer_start(&i2c_timeout_timer, I2C_TIMEOUT_MS, I2C_TIMEOUT_MS, i2c_timeout_cb);
+      }
+  }
+
+  CORE_EXIT_CRITICAL();
 }
 
 /***************************************************************************//**
@@ -320,7 +772,8 @@ void i2c_start(I2C_START_STRUCT *i2c_start) {
  *   Initialized the I2C module and prepares for the operation.
  *
  * @details
- *   Initializes the I2C including setting the clock tree and interrupts
+ *   Initializes the I2C including setting the clock tree and interrupts, and
+ *   the LDMA used for long transfers.
  *
  * @note
  *   Call this function before starting any I2C operations
@@ -333,12 +786,11 @@ void i2c_start(I2C_START_STRUCT *i2c_start) {
  *
  ******************************************************************************/
 void i2c_open(I2C_TypeDef *I2Cx, I2C_OPEN_STRUCT *i2c_setup) {
+  bool which = I2C_BUS_WHICH(I2Cx);
+  I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_state_machines[which];
+
   // Enable Clock
-  if (I2Cx == I2C0) {
-      CMU_ClockEnable(cmuClock_I2C0, true);
-  } else if (I2Cx == I2C1) {
-      CMU_ClockEnable(cmuClock_I2C1, true);
-  }
+  CMU_ClockEnable(I2C_BUS_CLOCK(which), true);
 
   // Test IF Register
   if ((I2Cx->IF & 0x01) == 0) { I2Cx->IFS = 0x01;
@@ -369,16 +821,22 @@ void i2c_open(I2C_TypeDef *I2Cx, I2C_OPEN_STRUCT *i2c_setup) {
   I2Cx->ROUTEPEN |= I2C_ROUTEPEN_SDAPEN;
 
   // NVIC Enable Interrupts
-  if (I2Cx == I2C0) {
-      NVIC_EnableIRQ(I2C0_IRQn);
-      i2c0_state_machine.busy = false;
-  } else if (I2Cx == I2C1) {
-      NVIC_EnableIRQ(I2C1_IRQn);
-      i2c1_state_machine.busy = false;
-  }
+  NVIC_EnableIRQ(I2C_BUS_IRQN(which));
+  i2c_sm->busy = false;
+  i2c_sm->queue_head = 0;
+  i2c_sm->queue_count = 0;
+  i2c_sm->ldma_channel = I2C_BUS_LDMA_CH(which);
+  i2c_sm->ldma_active = false;
+  i2c_sm->launches = 0;
+  i2c_sm->checked_launches = 0;
+  i2c_sm->errors = (I2C_ERROR_STRUCT){0};
 
   // Interrupt Enables
-  I2Cx->IEN |= (I2C_IEN_ACK | I2C_IEN_NACK | I2C_IEN_MSTOP | I2C_IEN_RXDATAV);
+  I2Cx->IEN |= (I2C_IEN_ACK | I2C_IEN_NACK | I2C_IEN_MSTOP | I2C_IEN_RXDATAV
+      | I2C_IEN_ARBLOST | I2C_IEN_BUSERR);
+
+  // Long transfers move their data bytes by LDMA
+  ldma_open();
 
   // Perform Bus Reset
   i2c_bus_reset(I2Cx);
@@ -386,6 +844,31 @@ void i2c_open(I2C_TypeDef *I2Cx, I2C_OPEN_STRUCT *i2c_setup) {
 
 
 
+/***************************************************************************//**
+ * @brief
+ *   Service routine for when the LDMA is done with an I2C transfer.
+ *
+ * @details
+ *   The LDMA has already turned AUTOACK off, so the last byte of the read is
+ *   held on the bus until the RXDATAV interrupt enabled here NACKs it.
+ *
+ * @note
+ *   This function is called from the LDMA interrupt. How late it runs only
+ *   stretches the last byte, it cannot change how the byte is acknowledged.
+ *
+ * @param[in] channel
+ *  LDMA channel of the finished transfer
+ ******************************************************************************/
+static void i2c_ldma_done(uint32_t channel) {
+  bool which = (channel == I2C1_LDMA_CH);
+  I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_state_machines[which];
+  I2C_TypeDef *i2cx = I2C_BUS(which);
+  EFM_ASSERT(i2c_sm->ldma_active);
+
+  EFM_ASSERT(i2c_sm->comm_method == I2C_READ);
+  i2cx->IEN |= I2C_IEN_RXDATAV;
+}
+
 /***************************************************************************//**
  * @brief
  *   Service routine for I2C interrupts
@@ -395,41 +878,44 @@ void i2c_open(I2C_TypeDef *I2Cx, I2C_OPEN_STRUCT *i2c_setup) {
  *   those interrupts to the corresponding state machine function.
  *
  * @note
- *   This function should not be called from outside the I2C module.
+ *   This function should not be called from outside the I2C module. It is
+ *   inlined into each IRQ handler with a constant bus, so the peripheral and
+ *   state machine addresses fold into the handler.
  *
- * @param[in] i2cx
- *  I2C peripheral struct
+ * @param[in] which
+ *  false = I2C0, true = I2C1
  ******************************************************************************/
-static void i2c_isr(I2C_TypeDef *i2cx) {
-  I2C_STATE_MACHINE_STRUCT *i2c_sm;
-  if (i2cx == I2C0) {
-      i2c_sm = &i2c0_state_machine;
-  } else if (i2cx == I2C1) {
-      i2c_sm = &i2c1_state_machine;
-  } else {
-      EFM_ASSERT(false);
-  }
+static inline __attribute__((always_inline)) void i2c_isr(bool which) {
+  I2C_TypeDef *i2cx = I2C_BUS(which);
+  I2C_STATE_MACHINE_STRUCT *i2c_sm = &i2c_state_machines[which];
 
   uint32_t int_flag = i2cx->IF & i2cx->IEN;
   i2cx->IFC = int_flag; // Clear IF register
+  uint32_t resets = i2c_sm->errors.resets; // Flags left after a recovery belong to the broken transfer
 
 
+  if (int_flag & (I2C_IF_ARBLOST | I2C_IF_BUSERR)) {
+      i2c_sm->errors.bus_errors++;
+      i2c_recover(i2c_sm, i2cx, I2C_STATUS_BUS_ERROR);
+      return;
+  }
+
   if (int_flag & I2C_IF_ACK) {
       EFM_ASSERT(!(i2cx->IF & I2C_IF_ACK));
       i2c_ack_sm(i2c_sm, i2cx);
 
   }
 
-  if (int_flag & I2C_IF_NACK) {
+  if ((int_flag & I2C_IF_NACK) && resets == i2c_sm->errors.resets) {
       EFM_ASSERT(!(i2cx->IF & I2C_IF_NACK));
       i2c_nack_sm(i2c_sm, i2cx);
   }
 
-  if (int_flag & I2C_IF_RXDATAV) {
+  if ((int_flag & I2C_IF_RXDATAV) && resets == i2c_sm->errors.resets) {
       i2c_rxdatav_sm(i2c_sm, i2cx);
   }
 
-  if (int_flag & I2C_IF_MSTOP) {
+  if ((int_flag & I2C_IF_MSTOP) && resets == i2c_sm->errors.resets) {
       EFM_ASSERT(!(i2cx->IF & I2C_IF_MSTOP));
       i2c_stop_sm(i2c_sm, i2cx);
   }
@@ -446,7 +932,8 @@ static void i2c_isr(I2C_TypeDef *i2cx) {
  *   This function is automatically called when I2C0 has an interrupt.
  ******************************************************************************/
 void I2C0_IRQHandler() {
-  i2c_isr(I2C0);
+  BENCH_ISR();
+  i2c_isr(false);
 }
 
 /***************************************************************************//**
@@ -460,7 +947,8 @@ void I2C0_IRQHandler() {
  *   This function is automatically called when I2C1 has an interrupt.
  ******************************************************************************/
 void I2C1_IRQHandler() {
-  i2c_isr(I2C1);
+  BENCH_ISR();
+  i2c_isr(true);
 }
 
 
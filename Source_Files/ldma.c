@@ -0,0 +1,134 @@
+/*****************************************************
+ * @file ldma.c
+ * @author Branson Camp
+ * @date 12/07/2022
+ * @brief Shares the LDMA between the drivers and
+ * routes each channel's done interrupt to its owner.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "ldma.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static bool ldma_opened;
+static LDMA_DONE_HANDLER done_handlers[LDMA_NUM_CHANNELS]; // Indexed by channel
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes the LDMA.
+ *
+ * @details
+ *   Enables the LDMA clock and interrupt. Every driver that uses the LDMA
+ *   calls this function from its open function, so only the first call
+ *   initializes the peripheral.
+ *
+ * @note
+ *   The LDMA only runs in EM0 and EM1. Drivers must block EM2 while one of
+ *   their transfers is in progress, unless their peripheral wakes the LDMA
+ *   out of EM2 as the LEUART does.
+ *
+ ******************************************************************************/
+void ldma_open(void) {
+  if (ldma_opened) {
+      return;
+  }
+
+  LDMA_Init_t ldma_init = LDMA_INIT_DEFAULT;
+  LDMA_Init(&ldma_init); // Enables the LDMA clock and NVIC interrupt
+  ldma_opened = true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a transfer on an LDMA channel.
+ *
+ * @details
+ *   The done handler is called from the LDMA interrupt once the descriptor
+ *   has been completed.
+ *
+ * @note
+ *   The descriptor is read by the LDMA and must stay valid until the transfer
+ *   is done.
+ *
+ * @param[in] channel
+ *  LDMA channel to be used
+ *
+ * @param[in] cfg
+ *  Transfer configuration, selects the peripheral request signal
+ *
+ * @param[in] desc
+ *  First descriptor of the transfer, later ones are reached by their links
+ *
+ * @param[in] done
+ *  Function called from interrupt context when the transfer is done
+ ******************************************************************************/
+void ldma_start(uint32_t channel, const LDMA_TransferCfg_t *cfg, const LDMA_Descriptor_t *desc, LDMA_DONE_HANDLER done) {
+  EFM_ASSERT(ldma_opened);
+  EFM_ASSERT(channel < LDMA_NUM_CHANNELS);
+
+  done_handlers[channel] = done;
+  LDMA_StartTransfer(channel, cfg, desc);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Stops the transfer on an LDMA channel.
+ *
+ * @details
+ *   The done handler of the channel is not called for a stopped transfer.
+ *
+ * @param[in] channel
+ *  LDMA channel to be stopped
+ ******************************************************************************/
+void ldma_stop(uint32_t channel) {
+  EFM_ASSERT(channel < LDMA_NUM_CHANNELS);
+
+  LDMA_StopTransfer(channel);
+  done_handlers[channel] = NULL;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Interrupt handler for the LDMA.
+ *
+ * @details
+ *   Calls the done handler of every channel whose transfer has completed.
+ *   A bus error from the LDMA is not expected and traps.
+ *
+ * @note
+ *   This function is automatically called when the LDMA has an interrupt.
+ ******************************************************************************/
+void LDMA_IRQHandler(void) {
+  BENCH_ISR();
+  uint32_t int_flag = LDMA_IntGetEnabled();
+  LDMA_IntClear(int_flag);
+  EFM_ASSERT(!(int_flag & LDMA_IF_ERROR));
+
+  uint32_t done = int_flag & ((1u << LDMA_NUM_CHANNELS) - 1);
+  while (done) {
+      uint32_t channel = 31 - __CLZ(done);
+      done &= ~(1u << channel);
+      if (done_handlers[channel]) {
+          done_handlers[channel](channel);
+      }
+  }
+}
@@ -18,11 +18,16 @@
 
 //** User/developer include files
 #include "letimer.h"
+#include "swtimer.h"
 
 // Private Variables
 static uint32_t scheduled_comp0_cb;
 static uint32_t scheduled_comp1_cb;
 static uint32_t scheduled_uf_cb;
+static bool comp1_cb_enable; // COMP1 is shared with the software timers
+
+static uint32_t letimer_epoch; // Ticks elapsed before the current period
+static uint32_t letimer_top; // Top value of the current period
 
 
 /***************************************************************************//**
@@ -41,6 +46,12 @@ static uint32_t scheduled_uf_cb;
  *   function letimer_start() is called to turn-on or turn-off the LETIMER PWM
  *   operation.
  *
+ * @note
+ *   COMP1 only holds the active period until the first software timer is
+ *   armed. From then on letimer_comp1_deadline() loads it with deadlines, so
+ *   the PWM outputs would toggle at those instead of the active period. The
+ *   outputs must stay disabled, and COMP1 events follow the deadlines too.
+ *
  * @param[in] letimer
  *   Pointer to the base peripheral address of the LETIMER peripheral being opened
  *
@@ -89,7 +100,7 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	// Initialize letimer for PWM operation
 	// XXX are values passed into the driver via app_letimer_struct
 	// ZZZ are values that you must specify for this PWM specific driver
-	letimer_pwm_values.bufTop = true;		// Comp1 will not be used to load comp0, but used to create an on-time/duty cycle
+	letimer_pwm_values.bufTop = false;		// Comp1 will not be used to load comp0, it is used for the on-time/duty cycle and delays
 	letimer_pwm_values.comp0Top = true;		// load comp0 into cnt register when count register underflows enabling continuous looping
 	letimer_pwm_values.debugRun = app_letimer_struct->debugRun;
 	letimer_pwm_values.enable = app_letimer_struct->enable;
@@ -120,6 +131,7 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 	 * Use the values from app_letimer_struct input argument for ROUTELOC0 and ROUTEPEN enable
 	 */
 	letimer->REP0 = 1; // Anything non-zero should work; timer is in free-running mode
+	EFM_ASSERT(!app_letimer_struct->out_pin_0_en && !app_letimer_struct->out_pin_1_en); // COMP1 belongs to the software timers
 	letimer->ROUTEPEN |= app_letimer_struct->out_pin_0_en; // Enable output 0
 	letimer->ROUTEPEN |= app_letimer_struct->out_pin_1_en << 1; // Enable output 1
 	letimer->ROUTELOC0 = app_letimer_struct->out_pin_route0;
@@ -154,9 +166,14 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
   scheduled_comp0_cb = app_letimer_struct->comp0_cb;
   scheduled_comp1_cb = app_letimer_struct->comp1_cb;
   scheduled_uf_cb = app_letimer_struct->uf_cb;
+  comp1_cb_enable = app_letimer_struct->comp1_irq_enable;
+
+  // The counter starts at 0 and underflows into the first period
+  letimer_epoch = 0;
+  letimer_top = 0;
 
   if (letimer->STATUS & LETIMER_STATUS_RUNNING) {
-      sleep_block_mode(LETIMER_EM);
+      sleep_block_mode(LETIMER_EM, SLEEP_CALLER_LETIMER);
   }
 
 }
@@ -182,14 +199,14 @@ void letimer_pwm_open(LETIMER_TypeDef *letimer, APP_LETIMER_PWM_TypeDef *app_let
 void letimer_start(LETIMER_TypeDef *letimer, bool enable){
   if (enable) {
       if (!(letimer->STATUS & LETIMER_STATUS_RUNNING)) {
-          sleep_block_mode(LETIMER_EM);
+          sleep_block_mode(LETIMER_EM, SLEEP_CALLER_LETIMER);
       }
 
       letimer->CMD = LETIMER_CMD_START;
       while (letimer->SYNCBUSY);
   } else {
       if (letimer->STATUS & LETIMER_STATUS_RUNNING) {
-          sleep_unblock_mode(LETIMER_EM);
+          sleep_unblock_mode(LETIMER_EM, SLEEP_CALLER_LETIMER);
       }
 
       letimer->CMD = LETIMER_CMD_STOP;
@@ -197,6 +214,139 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable){
   }
 }
 
+/***************************************************************************//**
+ * @brief
+ *   Changes the period of a running LETIMER.
+ *
+ * @details
+ *   Loads COMP0 with the new top value, which the counter reloads from at the
+ *   next underflow. If the new period is shorter than what is left of the
+ *   current one, the current period is cut short so the new cadence starts
+ *   right away. The tick count stays continuous and pending delays are
+ *   re-armed against the new counter value.
+ *
+ * @note
+ *   Call this function after letimer_pwm_open. The period must fit the 16-bit
+ *   counter, 65 seconds at LETIMER_HZ.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @param[in] period_ms
+ *   New period in milliseconds
+ ******************************************************************************/
+void letimer_set_period(LETIMER_TypeDef *letimer, uint32_t period_ms) {
+  uint32_t top = (period_ms * LETIMER_HZ) / 1000;
+  EFM_ASSERT(top > 0 && top <= LETIMER_MAX_TOP);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  while (letimer->SYNCBUSY);
+  letimer->COMP0 = top;
+
+  uint32_t cnt = letimer->CNT;
+  if (cnt > top && !(letimer->IF & LETIMER_IF_UF)) {
+      // Count the cut period's elapsed ticks, then restart it at the new top
+      letimer_epoch += letimer_top - cnt;
+      letimer_top = top;
+      letimer->CNT = top;
+      swtimer_expire(); // COMP1 was armed against the old count
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of LETIMER ticks since the LETIMER was started.
+ *
+ * @details
+ *   The LETIMER counts down from COMP0 and reloads on underflow. The tick count
+ *   is built from the ticks of all completed periods plus the progress of the
+ *   current one, so it keeps increasing across underflows.
+ *
+ * @note
+ *   One tick is 1/LETIMER_HZ seconds. This function can be called from
+ *   interrupt context.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @return
+ *   Ticks since the LETIMER was started.
+ ******************************************************************************/
+uint32_t letimer_get_ticks(LETIMER_TypeDef *letimer) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  uint32_t ticks = letimer_epoch + (letimer_top - letimer->CNT);
+  if (letimer->IF & LETIMER_IF_UF) {
+      // Underflow has not been serviced yet, count the period it started
+      ticks = letimer_epoch + letimer_top + 1 + (letimer->COMP0 - letimer->CNT);
+  }
+  CORE_EXIT_CRITICAL();
+  return ticks;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Arms the COMP1 interrupt to fire at a given tick.
+ *
+ * @details
+ *   Loads COMP1 with the counter value that matches the deadline. Deadlines
+ *   beyond the current period leave COMP1 disabled, the underflow interrupt
+ *   will call swtimer_expire() to arm it again once the deadline falls
+ *   inside the period.
+ *
+ * @note
+ *   COMP1 writes need a few LETIMER ticks to synchronize, so the interrupt
+ *   may fire up to LETIMER_COMP_MARGIN ticks late but never early.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ *
+ * @param[in] deadline
+ *   Tick, as returned by letimer_get_ticks(), at which COMP1 should fire
+ ******************************************************************************/
+void letimer_comp1_deadline(LETIMER_TypeDef *letimer, uint32_t deadline) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  int32_t cnt = letimer->CNT;
+  int32_t target = (int32_t)letimer_top - (int32_t)(deadline - letimer_epoch);
+
+  if (target > cnt - LETIMER_COMP_MARGIN) {
+      target = cnt - LETIMER_COMP_MARGIN;
+  }
+
+  if (target >= 0 && !(letimer->IF & LETIMER_IF_UF)) {
+      while (letimer->SYNCBUSY);
+      letimer->COMP1 = target;
+      letimer->IFC = LETIMER_IFC_COMP1;
+      letimer->IEN |= LETIMER_IEN_COMP1;
+  } else if (!comp1_cb_enable) {
+      letimer->IEN &= ~LETIMER_IEN_COMP1; // Wait for the next underflow
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Disables the COMP1 deadline interrupt.
+ *
+ * @details
+ *   Called when no delays are pending. COMP1 stays enabled if the application
+ *   asked for COMP1 events in letimer_pwm_open().
+ *
+ * @note
+ *   This function can be called from interrupt context.
+ *
+ * @param[in] letimer
+ *   Pointer to the base peripheral address of the LETIMER peripheral
+ ******************************************************************************/
+void letimer_comp1_cancel(LETIMER_TypeDef *letimer) {
+  if (!comp1_cb_enable) {
+      letimer->IEN &= ~LETIMER_IEN_COMP1;
+  }
+}
+
 /***************************************************************************//**
  * @brief
  *   IRQ Handler for LETIMER
@@ -210,6 +360,7 @@ void letimer_start(LETIMER_TypeDef *letimer, bool enable){
  *   This function is is called several times each timer cycle.
  ******************************************************************************/
 void LETIMER0_IRQHandler(void) {
+  BENCH_ISR();
   uint32_t int_flag = LETIMER0->IF & LETIMER0->IEN;
   LETIMER0->IFC = int_flag; // Clear IF register
 
@@ -218,14 +369,23 @@ void LETIMER0_IRQHandler(void) {
       EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_COMP0));
   }
 
+  if (int_flag & LETIMER_IF_UF) {
+      // Start of a new period, CNT has been reloaded from COMP0
+      letimer_epoch += letimer_top + 1;
+      letimer_top = LETIMER0->COMP0;
+      add_scheduled_event(scheduled_uf_cb);
+      EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
+  }
+
   if (int_flag & LETIMER_IF_COMP1) {
-      add_scheduled_event(scheduled_comp1_cb);
+      if (comp1_cb_enable) {
+          add_scheduled_event(scheduled_comp1_cb);
+      }
       EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_COMP1));
   }
 
-  if (int_flag & LETIMER_IF_UF) {
-      add_scheduled_event(scheduled_uf_cb);
-      EFM_ASSERT(!(LETIMER0->IF & LETIMER_IF_UF));
+  if (int_flag & (LETIMER_IF_COMP1 | LETIMER_IF_UF)) {
+      swtimer_expire();
   }
 }
 
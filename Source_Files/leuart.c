@@ -0,0 +1,165 @@
+/*****************************************************
+ * @file leuart.c
+ * @author Branson Camp
+ * @date 12/18/2022
+ * @brief Sends buffers out of LEUART0 by LDMA while
+ * the core sleeps in EM2.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "leuart.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static volatile bool tx_busy;
+static LEUART_DONE_HANDLER tx_done;
+static LDMA_Descriptor_t tx_desc; // Read by the LDMA while the transfer runs
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void leuart_ldma_done(uint32_t channel);
+
+/***************************************************************************//**
+ * @brief
+ *   Service routine for when the LDMA has put the last byte in TXDATA.
+ *
+ * @details
+ *   The last byte may still be shifting out, so the transfer ends on the TXC
+ *   interrupt. A TXC flag left from a byte that ran dry between two DMA
+ *   requests is cleared first. If this interrupt ran so late that the last
+ *   byte is already out, the flag is set again by hand, since STATUS still
+ *   shows the completion.
+ ******************************************************************************/
+static void leuart_ldma_done(uint32_t channel) {
+  EFM_ASSERT(channel == LEUART0_LDMA_CH);
+  LEUART0->IFC = LEUART_IF_TXC;
+  LEUART0->IEN |= LEUART_IEN_TXC;
+  if (LEUART0->STATUS & LEUART_STATUS_TXC) {
+      LEUART0->IFS = LEUART_IFS_TXC;
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes the LEUART for DMA transmission.
+ *
+ * @details
+ *   LEUART0 is clocked from the LFRCO on the LFB branch. With TX DMA wake-up
+ *   enabled, the LEUART briefly wakes the LDMA out of EM2 whenever TXDATA is
+ *   empty, so the core stays asleep for the whole transfer.
+ *
+ * @note
+ *   cmu_open() must have routed the LFRCO to the LFB branch.
+ *
+ * @param[in] leuart
+ *  LEUART peripheral struct, only LEUART0 is supported
+ *
+ * @param[in] leuart_setup
+ *  Struct containing the properties to initialize the LEUART with
+ ******************************************************************************/
+void leuart_open(LEUART_TypeDef *leuart, LEUART_OPEN_STRUCT *leuart_setup) {
+  EFM_ASSERT(leuart == LEUART0);
+  CMU_ClockEnable(cmuClock_LEUART0, true);
+
+  LEUART_Init_TypeDef leuart_init = LEUART_INIT_DEFAULT;
+  leuart_init.enable = leuart_setup->tx_enable ? leuartEnableTx : leuartDisable;
+  leuart_init.baudrate = leuart_setup->baudrate;
+  leuart_init.refFreq = 0; // Use the LFB clock frequency
+  LEUART_Init(leuart, &leuart_init);
+
+  while (leuart->SYNCBUSY);
+  leuart->CTRL |= LEUART_CTRL_TXDMAWU;
+
+  leuart->ROUTELOC0 = leuart_setup->tx_route;
+  leuart->ROUTEPEN = LEUART_ROUTEPEN_TXPEN;
+
+  leuart->IFC = LEUART_IF_TXC;
+  NVIC_EnableIRQ(LEUART0_IRQn);
+
+  tx_busy = false;
+  ldma_open();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts sending a buffer.
+ *
+ * @details
+ *   Returns immediately. The LDMA reads from the buffer directly, so it is
+ *   not copied and must stay valid until the done handler is called.
+ *
+ * @note
+ *   Only one buffer can be sent at a time. The done handler is called from
+ *   interrupt context once the last bit has left the pin and may start the
+ *   next buffer.
+ *
+ * @param[in] data
+ *  Bytes to send
+ *
+ * @param[in] bytes
+ *  Number of bytes to send
+ *
+ * @param[in] done
+ *  Function called when the buffer has been sent, or NULL
+ ******************************************************************************/
+void leuart_send(const uint8_t *data, uint32_t bytes, LEUART_DONE_HANDLER done) {
+  EFM_ASSERT(!tx_busy);
+  EFM_ASSERT(bytes > 0);
+
+  LDMA_TransferCfg_t ldma_cfg = LDMA_TRANSFER_CFG_PERIPHERAL(ldmaPeripheralSignal_LEUART0_TXBL);
+  LDMA_Descriptor_t ldma_desc = LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(data, &LEUART0->TXDATA, bytes);
+  tx_desc = ldma_desc;
+  tx_done = done;
+  tx_busy = true;
+
+  sleep_block_mode(LEUART_TX_EM, SLEEP_CALLER_LEUART);
+  ldma_start(LEUART0_LDMA_CH, &ldma_cfg, &tx_desc, leuart_ldma_done);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Checks whether a buffer is being sent.
+ ******************************************************************************/
+bool leuart_busy(void) {
+  return tx_busy;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Interrupt handler for LEUART0.
+ *
+ * @details
+ *   Ends the transfer once the last byte has been shifted out, allows EM3
+ *   again and calls the done handler.
+ *
+ * @note
+ *   This function is automatically called when LEUART0 has an interrupt.
+ ******************************************************************************/
+void LEUART0_IRQHandler(void) {
+  BENCH_ISR();
+  uint32_t int_flag = LEUART0->IF & LEUART0->IEN;
+  LEUART0->IFC = int_flag;
+
+  if (int_flag & LEUART_IF_TXC) {
+      LEUART0->IEN &= ~LEUART_IEN_TXC;
+      tx_busy = false;
+      sleep_unblock_mode(LEUART_TX_EM, SLEEP_CALLER_LEUART);
+      if (tx_done) {
+          tx_done();
+      }
+  }
+}
@@ -0,0 +1,142 @@
+/*****************************************************
+ * @file profile.c
+ * @author Branson Camp
+ * @date 12/12/2022
+ * @brief Named sampling profiles that trade power
+ * against responsiveness at run time.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "profile.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static const PROFILE_STRUCT profiles[PROFILE_COUNT] = {
+  {
+    .name = "responsive",
+    .period_ms = 1000,
+    .si7021_res = SI7021_RES_RH12_T14,
+    .shtc3_power = SHTC3_POWER_NORMAL,
+    .batch_size = 8,
+    .si7021_active = true,
+    .shtc3_active = true,
+  },
+  {
+    .name = "default",
+    .period_ms = 3000,
+    .si7021_res = SI7021_RES_BITS(SI7021_USER_SETTINGS),
+    .shtc3_power = SHTC3_POWER_NORMAL,
+    .batch_size = 40,
+    .si7021_active = true,
+    .shtc3_active = true,
+  },
+  {
+    .name = "low power",
+    .period_ms = 30000,
+    .si7021_res = SI7021_RES_RH8_T12,
+    .shtc3_power = SHTC3_POWER_LOW,
+    .batch_size = 40,
+    .si7021_active = false,
+    .shtc3_active = true,
+  },
+};
+
+static uint32_t active_profile; // Index of the profile the drivers run with
+static uint32_t selected_profile; // Index of the profile applied at the next sample
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Selects the default profile.
+ *
+ * @details
+ *   The drivers boot with the settings of PROFILE_DEFAULT, so nothing is
+ *   applied here.
+ *
+ * @note
+ *   This function should be called once before the first sample.
+ ******************************************************************************/
+void profile_open(void) {
+  active_profile = PROFILE_DEFAULT;
+  selected_profile = PROFILE_DEFAULT;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Selects the next profile, wrapping around after the last one.
+ *
+ * @note
+ *   The profile is applied by profile_apply_pending() at the next sample.
+ ******************************************************************************/
+void profile_next(void) {
+  selected_profile = (selected_profile + 1) % PROFILE_COUNT;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Selects the previous profile, wrapping around before the first one.
+ *
+ * @note
+ *   The profile is applied by profile_apply_pending() at the next sample.
+ ******************************************************************************/
+void profile_previous(void) {
+  selected_profile = (selected_profile + PROFILE_COUNT - 1) % PROFILE_COUNT;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Applies the selected profile if it changed.
+ *
+ * @details
+ *   The sensor resolution and mode, the batch size and the LETIMER0 period
+ *   are all changed in one call, so every sample runs entirely under one
+ *   profile.
+ *
+ * @note
+ *   This function should be called at the start of a sample, while no
+ *   sensor read is running.
+ *
+ * @return
+ *   True if a new profile was applied.
+ ******************************************************************************/
+bool profile_apply_pending(void) {
+  if (selected_profile == active_profile) {
+      return false;
+  }
+
+  const PROFILE_STRUCT *profile = &profiles[selected_profile];
+  si7021_set_resolution(profile->si7021_res);
+  shtc3_set_measure_mode(profile->shtc3_power, false);
+  sample_buffer_set_batch_size(profile->batch_size);
+  cadence_set_fast_period(profile->period_ms);
+  active_profile = selected_profile;
+  return true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the profile the drivers run with.
+ *
+ * @return
+ *   The active profile.
+ ******************************************************************************/
+const PROFILE_STRUCT *profile_get(void) {
+  return &profiles[active_profile];
+}
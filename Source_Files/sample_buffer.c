@@ -0,0 +1,343 @@
+/*****************************************************
+ * @file sample_buffer.c
+ * @author Branson Camp
+ * @date 12/05/2022
+ * @brief Stores raw sensor readings in SRAM using
+ * delta/varint encoded blocks until they are drained.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sample_buffer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static SAMPLE_BLOCK sample_blocks[SAMPLE_NUM_BLOCKS];
+static uint32_t block_head;     // Oldest block
+static uint32_t block_count;    // Blocks in use, the newest one is open for records
+
+static uint32_t prev_time;                          // Timestamp of the last record in the open block
+static uint16_t prev_code[SAMPLE_MAX_CHANNELS];     // Last code of each channel in the open block
+
+static uint32_t record_count;   // Records in the buffer
+static uint32_t dropped_count;  // Records lost because the buffer was full
+static uint32_t batch_size;
+static uint32_t batch_cb;
+static bool batch_scheduled;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Writes an unsigned varint.
+ *
+ * @details
+ *   Seven bits are stored per byte, least significant group first. The top bit
+ *   of each byte is set when more bytes follow.
+ *
+ * @param[in] out
+ *   Destination of the encoded bytes.
+ *
+ * @param[in] value
+ *   Value to encode.
+ *
+ * @return
+ *   Number of bytes written.
+ ******************************************************************************/
+static uint32_t varint_put(uint8_t *out, uint32_t value) {
+  uint32_t len = 0;
+  while (value >= 0x80) {
+      out[len++] = (value & 0x7F) | 0x80;
+      value >>= 7;
+  }
+  out[len++] = value;
+  return len;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reads an unsigned varint written by varint_put().
+ *
+ * @param[in] in
+ *   Encoded bytes.
+ *
+ * @param[in] available
+ *   Number of bytes that may be read.
+ *
+ * @param[out] value
+ *   Decoded value.
+ *
+ * @return
+ *   Number of bytes read, 0 if the varint is truncated.
+ ******************************************************************************/
+static uint32_t varint_get(const uint8_t *in, uint32_t available, uint32_t *value) {
+  uint32_t result = 0;
+  for (uint32_t len = 0; len < available && len < 5; len++) {
+      result |= (uint32_t)(in[len] & 0x7F) << (7 * len);
+      if (!(in[len] & 0x80)) {
+          *value = result;
+          return len + 1;
+      }
+  }
+  return 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Encodes one reading relative to the previous record of the open block.
+ *
+ * @details
+ *   A record is varint((time delta << 2) | channel) followed by the zigzag
+ *   varint of the code's change since the channel's last record.
+ *
+ * @return
+ *   Number of bytes written, at most SAMPLE_MAX_RECORD_BYTES.
+ ******************************************************************************/
+static uint32_t sample_encode(uint8_t *out, uint32_t channel, uint16_t code, uint32_t time) {
+  int32_t delta = (int32_t)code - (int32_t)prev_code[channel];
+  uint32_t zigzag = (delta << 1) ^ (delta >> 31);
+  uint32_t len = varint_put(out, ((time - prev_time) << 2) | channel);
+  return len + varint_put(&out[len], zigzag);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a new block for records at the given time.
+ *
+ * @details
+ *   When every block is in use, the oldest block is dropped.
+ ******************************************************************************/
+static void sample_new_block(uint32_t time) {
+  if (block_count == SAMPLE_NUM_BLOCKS) {
+      record_count -= sample_blocks[block_head].num_records;
+      dropped_count += sample_blocks[block_head].num_records;
+      block_head = (block_head + 1) % SAMPLE_NUM_BLOCKS;
+      block_count--;
+  }
+
+  SAMPLE_BLOCK *block = &sample_blocks[(block_head + block_count) % SAMPLE_NUM_BLOCKS];
+  block->base_time = time;
+  block->num_records = 0;
+  block->num_bytes = 0;
+  block_count++;
+
+  prev_time = time;
+  for (int i = 0; i < SAMPLE_MAX_CHANNELS; i++) {
+      prev_code[i] = 0;
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes the sample buffer.
+ *
+ * @details
+ *   Empties the buffer. Once batch_size records have been added, batch_cb is
+ *   scheduled so the records can be drained in one burst.
+ *
+ * @note
+ *   This function should be called once before any samples are added.
+ *
+ * @param[in] size
+ *   Number of records per batch.
+ *
+ * @param[in] cb
+ *   Callback code scheduled when a batch is ready.
+ ******************************************************************************/
+void sample_buffer_open(uint32_t size, uint32_t cb) {
+  block_head = 0;
+  block_count = 0;
+  record_count = 0;
+  dropped_count = 0;
+  batch_size = size;
+  batch_cb = cb;
+  batch_scheduled = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Changes the number of records per batch.
+ *
+ * @details
+ *   If the buffer already holds a full batch of the new size, the batch
+ *   event is scheduled right away.
+ *
+ * @param[in] size
+ *   Number of records per batch.
+ ******************************************************************************/
+void sample_buffer_set_batch_size(uint32_t size) {
+  batch_size = size;
+  if (!batch_scheduled && batch_size > 0 && record_count >= batch_size) {
+      batch_scheduled = true;
+      add_scheduled_event(batch_cb);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Adds a raw sensor reading to the buffer.
+ *
+ * @details
+ *   The reading is encoded into the open block, or into a new block if it
+ *   does not fit. If the buffer is full the oldest block is dropped.
+ *
+ * @note
+ *   Timestamps must not decrease between calls.
+ *
+ * @param[in] channel
+ *   Channel of the reading, below SAMPLE_MAX_CHANNELS.
+ *
+ * @param[in] code
+ *   Raw 16-bit sensor code.
+ *
+ * @param[in] time
+ *   Timestamp of the reading, such as letimer_get_ticks().
+ ******************************************************************************/
+void sample_buffer_add(uint32_t channel, uint16_t code, uint32_t time) {
+  EFM_ASSERT(channel < SAMPLE_MAX_CHANNELS);
+
+  uint8_t record[SAMPLE_MAX_RECORD_BYTES];
+  uint32_t len = 0;
+  SAMPLE_BLOCK *block = NULL;
+
+  if (block_count > 0) {
+      block = &sample_blocks[(block_head + block_count - 1) % SAMPLE_NUM_BLOCKS];
+      len = sample_encode(record, channel, code, time);
+  }
+
+  if (block == NULL || block->num_bytes + len > SAMPLE_BLOCK_DATA_BYTES || block->num_records == UINT8_MAX) {
+      sample_new_block(time);
+      block = &sample_blocks[(block_head + block_count - 1) % SAMPLE_NUM_BLOCKS];
+      len = sample_encode(record, channel, code, time);
+  }
+
+  for (uint32_t i = 0; i < len; i++) {
+      block->data[block->num_bytes++] = record[i];
+  }
+  block->num_records++;
+  prev_time = time;
+  prev_code[channel] = code;
+  record_count++;
+
+  if (!batch_scheduled && batch_size > 0 && record_count >= batch_size) {
+      batch_scheduled = true;
+      add_scheduled_event(batch_cb);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of records in the buffer.
+ *
+ * @return
+ *   Records waiting to be drained.
+ ******************************************************************************/
+uint32_t sample_buffer_count(void) {
+  return record_count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of records dropped because the buffer was full.
+ *
+ * @return
+ *   Records dropped since sample_buffer_open().
+ ******************************************************************************/
+uint32_t sample_buffer_dropped(void) {
+  return dropped_count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Moves the oldest blocks out of the buffer.
+ *
+ * @details
+ *   Copies up to max_blocks blocks, oldest first, and frees them. The open
+ *   block is included, so the next reading starts a new block. Each block can
+ *   be decoded on its own with sample_block_decode().
+ *
+ * @param[out] blocks
+ *   Destination for the drained blocks.
+ *
+ * @param[in] max_blocks
+ *   Number of blocks that fit in the destination.
+ *
+ * @return
+ *   Number of blocks drained.
+ ******************************************************************************/
+uint32_t sample_buffer_drain(SAMPLE_BLOCK *blocks, uint32_t max_blocks) {
+  uint32_t drained = 0;
+  while (drained < max_blocks && block_count > 0) {
+      blocks[drained] = sample_blocks[block_head];
+      record_count -= sample_blocks[block_head].num_records;
+      block_head = (block_head + 1) % SAMPLE_NUM_BLOCKS;
+      block_count--;
+      drained++;
+  }
+
+  if (record_count < batch_size) {
+      batch_scheduled = false;
+  }
+  return drained;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Decodes the records of a drained block.
+ *
+ * @details
+ *   Reverses the delta/varint encoding of sample_buffer_add().
+ *
+ * @param[in] block
+ *   Block returned by sample_buffer_drain().
+ *
+ * @param[out] records
+ *   Destination for the decoded records.
+ *
+ * @param[in] max_records
+ *   Number of records that fit in the destination.
+ *
+ * @return
+ *   Number of records decoded.
+ ******************************************************************************/
+uint32_t sample_block_decode(const SAMPLE_BLOCK *block, SAMPLE_RECORD *records, uint32_t max_records) {
+  uint32_t time = block->base_time;
+  uint16_t code[SAMPLE_MAX_CHANNELS] = {0};
+  uint32_t pos = 0;
+  uint32_t decoded = 0;
+
+  while (decoded < block->num_records && decoded < max_records) {
+      uint32_t header, zigzag, len;
+
+      len = varint_get(&block->data[pos], block->num_bytes - pos, &header);
+      if (len == 0) break;
+      pos += len;
+      len = varint_get(&block->data[pos], block->num_bytes - pos, &zigzag);
+      if (len == 0) break;
+      pos += len;
+
+      uint32_t channel = header & (SAMPLE_MAX_CHANNELS - 1);
+      time += header >> 2;
+      code[channel] += (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+
+      records[decoded].time = time;
+      records[decoded].channel = channel;
+      records[decoded].code = code[channel];
+      decoded++;
+  }
+  return decoded;
+}
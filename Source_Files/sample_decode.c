@@ -0,0 +1,60 @@
+/*****************************************************
+ * @file sample_decode.c
+ * @author Branson Camp
+ * @date 12/16/2022
+ * @brief Converts logged raw sensor codes into
+ * centi-units, for whoever reads the log back.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sample_decode.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Converts an array of raw codes of one channel to centi-units.
+ *
+ * @details
+ *   The loop has no branches or aliasing and the same scale for every code,
+ *   so the compiler can unroll it and keep the gain and offset in registers.
+ *
+ * @param[in] codes
+ *  Raw 16-bit codes
+ *
+ * @param[out] centi
+ *  Converted values, must not overlap the codes
+ *
+ * @param[in] count
+ *  Number of codes
+ *
+ * @param[in] scale
+ *  Conversion of the channel
+ ******************************************************************************/
+void sample_decode_convert(const uint16_t *restrict codes, int32_t *restrict centi, uint32_t count, const SAMPLE_DECODE_SCALE_STRUCT *scale) {
+  const uint32_t gain = scale->gain;
+  const int32_t offset = scale->offset;
+  for (uint32_t i = 0; i < count; i++) {
+      centi[i] = (int32_t)((gain * codes[i]) >> 16) + offset;
+  }
+}
@@ -7,21 +7,147 @@
  *
  ****************************************************/
 
+#include "em_device.h"
 #include "em_assert.h"
 #include "em_core.h"
 #include "em_emu.h"
 
 #include "scheduler.h"
+#ifdef SCHEDULER_TRACE_ITM
+#include "em_gpio.h"
+#endif
 
-static uint32_t event_scheduled;
+// ARMv7-M cores (Cortex-M3/M4) can update the event mask with exclusive accesses
+// instead of masking interrupts
+#if defined(__CORTEX_M) && (__CORTEX_M >= 3U)
+#define SCHEDULER_EXCLUSIVE_ACCESS  1
+#else
+#define SCHEDULER_EXCLUSIVE_ACCESS  0
+#endif
+
+static volatile uint32_t event_scheduled;
+static SCHEDULER_HANDLER event_handlers[SCHEDULER_MAX_EVENTS]; // Indexed by event bit
+static uint32_t priority_events[SCHEDULER_NUM_PRIORITIES]; // Registered events per priority
+
+typedef struct {
+  uint32_t members; // Events to wait for, 0 when the barrier is free
+  uint32_t seen; // Members dispatched since the barrier was armed
+  uint32_t join_event; // Event scheduled once every member has been seen
+} SCHEDULER_BARRIER_STRUCT;
+
+static SCHEDULER_BARRIER_STRUCT barriers[SCHEDULER_MAX_BARRIERS];
+
+typedef struct {
+  SCHEDULER_MESSAGE_STRUCT message;
+  uint32_t seq; // Post order, the oldest message of an event is received first
+  bool used;
+} SCHEDULER_SLOT_STRUCT;
+
+static SCHEDULER_SLOT_STRUCT message_slots[SCHEDULER_QUEUE_SIZE];
+static uint32_t message_seq; // seq of the next posted message
+static uint32_t messages_dropped; // Posts lost because every slot was used
+
+#ifdef SCHEDULER_TRACE
+static uint32_t post_cycles[SCHEDULER_MAX_EVENTS]; // CYCCNT when each pending event was first posted
+static SCHEDULER_TRACE_STRUCT event_trace[SCHEDULER_MAX_EVENTS]; // Indexed by event bit
+
+/***************************************************************************//**
+ * @brief
+ *   Stamps the events that have just become pending.
+ *
+ * @details
+ *   An event posted again before it is dispatched keeps its first stamp, so
+ *   the latency covers the whole time it waited.
+ *
+ * @param[in] posted
+ *   Events that were not pending before this post
+ *
+ ******************************************************************************/
+static void scheduler_trace_post(uint32_t posted) {
+  uint32_t now = DWT->CYCCNT;
+  while (posted) {
+      uint32_t bit = 31 - __CLZ(posted);
+      posted &= ~(1u << bit);
+      post_cycles[bit] = now;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Records the timing of one dispatched handler.
+ *
+ * @details
+ *   In a SCHEDULER_TRACE_ITM build, the record is also written to the ITM
+ *   stimulus port as two words: the event bit with the latency in the low
+ *   24 bits, then the run time.
+ *
+ * @param[in] bit
+ *   Event bit that was dispatched
+ *
+ * @param[in] start
+ *   CYCCNT when the handler was called
+ *
+ * @param[in] end
+ *   CYCCNT when the handler returned
+ *
+ ******************************************************************************/
+static void scheduler_trace_dispatch(uint32_t bit, uint32_t start, uint32_t end) {
+  SCHEDULER_TRACE_STRUCT *trace = &event_trace[bit];
+  uint32_t latency = start - post_cycles[bit];
+  uint32_t run = end - start;
+
+  if (trace->count == 0 || latency < trace->latency_min) {
+      trace->latency_min = latency;
+  }
+  if (latency > trace->latency_max) {
+      trace->latency_max = latency;
+  }
+  if (trace->count == 0 || run < trace->run_min) {
+      trace->run_min = run;
+  }
+  if (run > trace->run_max) {
+      trace->run_max = run;
+  }
+  trace->latency_sum += latency;
+  trace->run_sum += run;
+  trace->count++;
+
+#ifdef SCHEDULER_TRACE_ITM
+  if ((ITM->TCR & ITM_TCR_ITMENA_Msk) && (ITM->TER & (1u << SCHEDULER_TRACE_ITM_PORT))) {
+      while (ITM->PORT[SCHEDULER_TRACE_ITM_PORT].u32 == 0);
+      ITM->PORT[SCHEDULER_TRACE_ITM_PORT].u32 = (bit << 24) | (latency & 0xFFFFFF);
+      while (ITM->PORT[SCHEDULER_TRACE_ITM_PORT].u32 == 0);
+      ITM->PORT[SCHEDULER_TRACE_ITM_PORT].u32 = run;
+  }
+#endif
+}
+#endif
 
 
+/***************************************************************************//**
+ * @brief
+ *   Schedules an event again if messages are left for it.
+ *
+ * @param[in] event
+ *   Event that has just been dispatched
+ *
+ ******************************************************************************/
+static void scheduler_repost_messages(uint32_t event) {
+  for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++) {
+      if (message_slots[i].used && message_slots[i].message.event == event) {
+          add_scheduled_event(event);
+          return;
+      }
+  }
+}
+
 /***************************************************************************//**
  * @brief
  *   Configures/Resets the scheduler
  *
  * @details
- *   Clears the event scheduled variable so that no events are scheduled.
+ *   Clears the event scheduled variable so that no events are scheduled. In a
+ *   SCHEDULER_TRACE build, this also starts the DWT cycle counter.
  *
  * @note
  *   This function should be called when initializing the scheduler.
@@ -31,6 +157,263 @@ void scheduler_open(void) {
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
   event_scheduled = 0;
+  for (int i = 0; i < SCHEDULER_MAX_EVENTS; i++) {
+      event_handlers[i] = NULL;
+  }
+  for (int i = 0; i < SCHEDULER_NUM_PRIORITIES; i++) {
+      priority_events[i] = 0;
+  }
+  for (int i = 0; i < SCHEDULER_MAX_BARRIERS; i++) {
+      barriers[i].members = 0;
+  }
+  for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++) {
+      message_slots[i].used = false;
+  }
+  message_seq = 0;
+  messages_dropped = 0;
+  CORE_EXIT_CRITICAL();
+
+#ifdef SCHEDULER_TRACE
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  scheduler_trace_reset();
+#endif
+#ifdef SCHEDULER_TRACE_ITM
+  GPIO_DbgSWOEnable(true); // The debugger configures the ITM and SWO speed
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Registers the handler of an event.
+ *
+ * @details
+ *   The handler is called by scheduler_dispatch() whenever the event has been
+ *   scheduled. Events of a higher priority are dispatched first, events of the
+ *   same priority are dispatched from the highest event bit down.
+ *
+ * @note
+ *   This function should be called after scheduler_open(). Registering an
+ *   event again replaces its handler and priority.
+ *
+ * @param[in] event
+ *   Event to handle, a single bit.
+ *
+ * @param[in] priority
+ *   SCHEDULER_PRIORITY_HIGH, SCHEDULER_PRIORITY_MEDIUM or SCHEDULER_PRIORITY_LOW.
+ *
+ * @param[in] handler
+ *   Function called when the event is dispatched.
+ *
+ ******************************************************************************/
+void scheduler_register(uint32_t event, uint32_t priority, SCHEDULER_HANDLER handler) {
+  EFM_ASSERT(event && !(event & (event - 1))); // Exactly one bit
+  EFM_ASSERT(priority < SCHEDULER_NUM_PRIORITIES);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  for (int i = 0; i < SCHEDULER_NUM_PRIORITIES; i++) {
+      priority_events[i] &= ~event;
+  }
+  priority_events[priority] |= event;
+  event_handlers[31 - __CLZ(event)] = handler;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the handlers of all scheduled events.
+ *
+ * @details
+ *   Takes and clears all scheduled events in one atomic operation, then calls
+ *   the registered handlers in priority order. Each handler is found with a
+ *   count leading zeros on the pending bits, so dispatch does not depend on the
+ *   number of registered events. Scheduled events with no handler are dropped.
+ *
+ * @note
+ *   This function should be called from the main loop after waking up. Events
+ *   scheduled by the handlers are dispatched on the next call, as are the join
+ *   events of barriers completed by this call. An event whose handler left
+ *   messages in the queue is scheduled again, so each dispatch may receive
+ *   one message.
+ *
+ ******************************************************************************/
+void scheduler_dispatch(void) {
+  uint32_t pending = fetch_and_clear_events();
+
+  // Join barriers whose members are all in
+  for (int i = 0; i < SCHEDULER_MAX_BARRIERS && pending; i++) {
+      if (barriers[i].members) {
+          barriers[i].seen |= pending & barriers[i].members;
+          if (barriers[i].seen == barriers[i].members) {
+              barriers[i].members = 0;
+              add_scheduled_event(barriers[i].join_event);
+          }
+      }
+  }
+
+  for (int i = 0; i < SCHEDULER_NUM_PRIORITIES && pending; i++) {
+      uint32_t ready = pending & priority_events[i];
+      pending &= ~ready;
+      while (ready) {
+          uint32_t bit = 31 - __CLZ(ready);
+          ready &= ~(1u << bit);
+#ifdef SCHEDULER_TRACE
+          uint32_t start = DWT->CYCCNT;
+          event_handlers[bit]();
+          scheduler_trace_dispatch(bit, start, DWT->CYCCNT);
+#else
+          event_handlers[bit]();
+#endif
+          scheduler_repost_messages(1u << bit);
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Posts a message with a payload and schedules its event.
+ *
+ * @details
+ *   The payload is copied into a free queue slot, so the poster can reuse its
+ *   buffer right away. Messages of the same event do not coalesce like the
+ *   event bit does: each one is kept until it is received.
+ *
+ * @note
+ *   May be called from interrupts. The event's handler must receive its
+ *   messages with scheduler_receive(), one per dispatch.
+ *
+ * @param[in] event
+ *   Event to schedule, a single registered event bit.
+ *
+ * @param[in] payload
+ *   Bytes copied into the message, or NULL.
+ *
+ * @param[in] bytes
+ *   Number of payload bytes, up to SCHEDULER_PAYLOAD_BYTES.
+ *
+ * @param[in] status
+ *   Status passed to the receiver.
+ *
+ * @param[in] timestamp
+ *   Timestamp passed to the receiver.
+ *
+ * @return
+ *   False if the queue was full and the message was dropped. The event is
+ *   scheduled either way.
+ ******************************************************************************/
+bool scheduler_post(uint32_t event, const void *payload, uint32_t bytes, uint32_t status, uint32_t timestamp) {
+  EFM_ASSERT(event && !(event & (event - 1)));
+  EFM_ASSERT(event_handlers[31 - __CLZ(event)]);
+  EFM_ASSERT(bytes <= SCHEDULER_PAYLOAD_BYTES);
+
+  bool posted = false;
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++) {
+      if (!message_slots[i].used) {
+          SCHEDULER_MESSAGE_STRUCT *message = &message_slots[i].message;
+          message->event = event;
+          message->status = status;
+          message->timestamp = timestamp;
+          const uint8_t *bytes_in = payload;
+          for (uint32_t j = 0; j < bytes; j++) {
+              message->payload[j] = bytes_in[j];
+          }
+          message_slots[i].seq = message_seq++;
+          message_slots[i].used = true;
+          posted = true;
+          break;
+      }
+  }
+  if (!posted) {
+      messages_dropped++;
+  }
+  CORE_EXIT_CRITICAL();
+
+  add_scheduled_event(event);
+  return posted;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Takes the oldest message of an event off the queue.
+ *
+ * @note
+ *   This function should be called from the event's handler.
+ *
+ * @param[in] event
+ *   Event whose message to receive.
+ *
+ * @param[out] message
+ *   Copy of the message, left untouched if there is none.
+ *
+ * @return
+ *   True if a message was received.
+ ******************************************************************************/
+bool scheduler_receive(uint32_t event, SCHEDULER_MESSAGE_STRUCT *message) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  int oldest = -1;
+  for (int i = 0; i < SCHEDULER_QUEUE_SIZE; i++) {
+      if (message_slots[i].used && message_slots[i].message.event == event
+          && (oldest < 0 || (int32_t)(message_slots[i].seq - message_slots[oldest].seq) < 0)) {
+          oldest = i;
+      }
+  }
+  if (oldest >= 0) {
+      *message = message_slots[oldest].message;
+      message_slots[oldest].used = false;
+  }
+  CORE_EXIT_CRITICAL();
+  return oldest >= 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns the number of messages dropped because the queue was full.
+ ******************************************************************************/
+uint32_t scheduler_messages_dropped(void) {
+  return messages_dropped;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Arms a barrier that joins a set of events into one.
+ *
+ * @details
+ *   Once every member event has been scheduled at least once, the join event
+ *   is scheduled and the barrier is freed. The members are still dispatched
+ *   to their own handlers, and the join event is dispatched after them. This
+ *   lets work that runs in parallel, such as transfers on both I2C buses,
+ *   finish with a single event.
+ *
+ * @note
+ *   Arm the barrier before starting the work whose completion it waits for.
+ *   A member event that is still pending when this is called counts too.
+ *
+ * @param[in] members
+ *   Events to wait for, one or more bits.
+ *
+ * @param[in] join_event
+ *   Event scheduled once all members have been scheduled.
+ *
+ ******************************************************************************/
+void scheduler_barrier(uint32_t members, uint32_t join_event) {
+  EFM_ASSERT(members);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  int i = 0;
+  while (i < SCHEDULER_MAX_BARRIERS && barriers[i].members) {
+      i++;
+  }
+  EFM_ASSERT(i < SCHEDULER_MAX_BARRIERS);
+
+  barriers[i].seen = 0;
+  barriers[i].join_event = join_event;
+  barriers[i].members = members;
   CORE_EXIT_CRITICAL();
 }
 
@@ -44,16 +427,31 @@ void scheduler_open(void) {
  *
  * @note
  *   This function should be called whenever you want to schedule an event.
+ *   It does not mask interrupts on Cortex-M3/M4, an interrupt between the
+ *   exclusive load and store makes the store fail and the update is retried.
  *
  * @param[in] event
  *   Desired event to be scheduled.
  *
  ******************************************************************************/
 void add_scheduled_event(uint32_t event) {
+  uint32_t previous;
+#if SCHEDULER_EXCLUSIVE_ACCESS
+  do {
+      previous = __LDREXW(&event_scheduled);
+  } while (__STREXW(previous | event, &event_scheduled));
+#else
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
-  event_scheduled |= event;
+  previous = event_scheduled;
+  event_scheduled = previous | event;
   CORE_EXIT_CRITICAL();
+#endif
+#ifdef SCHEDULER_TRACE
+  scheduler_trace_post(event & ~previous);
+#else
+  (void)previous;
+#endif
 }
 
 /***************************************************************************//**
@@ -73,10 +471,49 @@ void add_scheduled_event(uint32_t event) {
  *
  ******************************************************************************/
 void remove_scheduled_event(uint32_t event) {
+#if SCHEDULER_EXCLUSIVE_ACCESS
+  uint32_t events;
+  do {
+      events = __LDREXW(&event_scheduled) & ~event;
+  } while (__STREXW(events, &event_scheduled));
+#else
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
   event_scheduled &= ~event;
   CORE_EXIT_CRITICAL();
+#endif
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns and clears all scheduled events.
+ *
+ * @details
+ *   Atomically swaps the scheduled events with 0, so an event scheduled from
+ *   an interrupt is either returned by this call or kept for the next one.
+ *
+ * @note
+ *   This function is used by scheduler_dispatch() to take the events it
+ *   will handle.
+ *
+ * @return
+ *    The events that were scheduled.
+ *
+ ******************************************************************************/
+uint32_t fetch_and_clear_events(void) {
+  uint32_t events;
+#if SCHEDULER_EXCLUSIVE_ACCESS
+  do {
+      events = __LDREXW(&event_scheduled);
+  } while (__STREXW(0, &event_scheduled));
+#else
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  events = event_scheduled;
+  event_scheduled = 0;
+  CORE_EXIT_CRITICAL();
+#endif
+  return events;
 }
 
 /***************************************************************************//**
@@ -99,6 +536,56 @@ uint32_t get_scheduled_events(void) {
   return event_scheduled;
 }
 
+#ifdef SCHEDULER_TRACE
+/***************************************************************************//**
+ * @brief
+ *   Copies the dispatch timing of an event.
+ *
+ * @details
+ *   Times are in core clock cycles. Latency runs from the first post of the
+ *   event to the start of its handler, which the main loop never sleeps
+ *   through. The DWT cycle counter stops while the core sleeps, so it cannot
+ *   time anything that spans a sleep.
+ *
+ * @note
+ *   Only available in a SCHEDULER_TRACE build.
+ *
+ * @param[in] event
+ *   Event to read, a single bit.
+ *
+ * @param[out] trace
+ *   Struct the event's timing is copied into
+ *
+ ******************************************************************************/
+void scheduler_trace_get(uint32_t event, SCHEDULER_TRACE_STRUCT *trace) {
+  EFM_ASSERT(event && !(event & (event - 1))); // Exactly one bit
 
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  *trace = event_trace[31 - __CLZ(event)];
+  CORE_EXIT_CRITICAL();
+}
 
-
+/***************************************************************************//**
+ * @brief
+ *   Clears the dispatch timing of all events.
+ *
+ * @note
+ *   Only available in a SCHEDULER_TRACE build.
+ *
+ ******************************************************************************/
+void scheduler_trace_reset(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  for (int i = 0; i < SCHEDULER_MAX_EVENTS; i++) {
+      event_trace[i].count = 0;
+      event_trace[i].latency_min = 0;
+      event_trace[i].latency_max = 0;
+      event_trace[i].latency_sum = 0;
+      event_trace[i].run_min = 0;
+      event_trace[i].run_max = 0;
+      event_trace[i].run_sum = 0;
+  }
+  CORE_EXIT_CRITICAL();
+}
+#endif
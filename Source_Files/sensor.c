@@ -0,0 +1,330 @@
+/*****************************************************
+ * @file sensor.c
+ * @author Branson Camp
+ * @date 12/10/2022
+ * @brief Runs the command sequences of the I2C
+ * sensors without blocking.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sensor.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static bool bus_opened[I2C_NUM_BUSES]; // Indexed by which_i2c
+static uint32_t startup_time; // Longest startup time of the opened sensors
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void sensor_start_transfers(SENSOR_STRUCT *sensor);
+static SENSOR_STATUS_TypeDef sensor_check(const SENSOR_STRUCT *sensor);
+static void sensor_done(SENSOR_STRUCT *sensor, SENSOR_STATUS_TypeDef status);
+static bool sensor_polls(const SENSOR_STEP_STRUCT *step);
+
+/***************************************************************************//**
+ * @brief
+ *   Queues the I2C steps starting at the sensor's next step.
+ *
+ * @details
+ *   Consecutive read and write steps are chained into one I2C transfer, so
+ *   they run back to back without waking the main loop in between. The last
+ *   one schedules the step event.
+ *
+ * @param[in] sensor
+ *  Sensor whose sequence is running
+ ******************************************************************************/
+static void sensor_start_transfers(SENSOR_STRUCT *sensor) {
+  const SENSOR_STEP_STRUCT *step = sensor->step;
+  I2C_START_STRUCT *first = NULL;
+  I2C_START_STRUCT *last = NULL;
+  uint32_t count = 0;
+
+  while (step->type == SENSOR_STEP_WRITE || step->type == SENSOR_STEP_READ) {
+      EFM_ASSERT(count < SENSOR_MAX_TRANSFERS);
+      I2C_START_STRUCT *transfer = &sensor->transfers[count++];
+      transfer->which_i2c = sensor->desc->which_i2c;
+      transfer->device_address = sensor->desc->device_address;
+      transfer->register_address = step->command;
+      transfer->num_register_bytes = step->num_command_bytes;
+      transfer->num_bytes = step->num_bytes;
+      transfer->finished_callback = 0x00;
+      transfer->next = NULL;
+      transfer->status = &sensor->status;
+      if (step->type == SENSOR_STEP_READ) {
+          EFM_ASSERT(step->offset + step->num_bytes <= SENSOR_RAW_BYTES);
+          transfer->comm_method = I2C_READ;
+          transfer->data = &sensor->raw[step->offset];
+      } else {
+          transfer->comm_method = I2C_WRITE;
+          transfer->data = step->data;
+      }
+
+      if (last) {
+          last->next = transfer;
+      } else {
+          first = transfer;
+      }
+      last = transfer;
+      step++;
+  }
+  sensor->step = step;
+
+  // Also at the end of the sequence, so the raw bytes are posted by sensor_step
+  last->finished_callback = sensor->step_cb;
+  i2c_start(first);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Checks the result of the last sequence's reads.
+ *
+ * @details
+ *   Only reads marked with a checksum in the sequence are checked.
+ *
+ * @param[in] sensor
+ *  Sensor whose sequence has just finished
+ *
+ * @return
+ *   SENSOR_STATUS_CRC_ERROR if a checksum does not match its data.
+ ******************************************************************************/
+static SENSOR_STATUS_TypeDef sensor_check(const SENSOR_STRUCT *sensor) {
+  for (const SENSOR_STEP_STRUCT *step = sensor->sequence; step->type != SENSOR_STEP_END; step++) {
+      if (step->type != SENSOR_STEP_READ || !step->crc) {
+          continue;
+      }
+      for (uint32_t i = 0; i + 3 <= step->num_bytes; i += 3) {
+          const uint8_t *word = &sensor->raw[step->offset + i];
+          if (crc8(word, 2, sensor->desc->crc_init) != word[2]) {
+              return SENSOR_STATUS_CRC_ERROR;
+          }
+      }
+  }
+  return SENSOR_STATUS_OK;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Ends the sequence and posts its raw bytes with the done event.
+ *
+ * @details
+ *   The raw bytes are copied into the message, so the next sequence can run
+ *   before the done event is handled.
+ *
+ * @param[in] sensor
+ *  Sensor whose sequence has finished
+ *
+ * @param[in] status
+ *  Result passed in the message
+ ******************************************************************************/
+static void sensor_done(SENSOR_STRUCT *sensor, SENSOR_STATUS_TypeDef status) {
+  sensor->busy = false;
+  // A full queue still schedules the event, the scheduler counts the drop
+  scheduler_post(sensor->done_cb, sensor->raw, SENSOR_RAW_BYTES, status, letimer_get_ticks(LETIMER0));
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Checks whether a step polls the sensor until it is ready.
+ *
+ * @details
+ *   A read without command bytes only sends the read header, which the
+ *   sensor NACKs while it is busy, so a delay in front of it may be skipped.
+ *   A write or a command is NACKed or lost instead.
+ ******************************************************************************/
+static bool sensor_polls(const SENSOR_STEP_STRUCT *step) {
+  return step->type == SENSOR_STEP_READ && step->num_command_bytes == 0;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Opens a sensor and the I2C bus it is on.
+ *
+ * @details
+ *   The bus is opened in fast mode on its board routes, the first time a
+ *   sensor on it is opened. Returns right away, the startup time is not
+ *   waited out here.
+ *
+ * @note
+ *   This function should be called once per sensor. No sequence may run
+ *   until sensor_startup_time() has passed since the sensors were powered.
+ *
+ * @param[in] sensor
+ *  Sensor to be opened
+ *
+ * @param[in] desc
+ *  Description of the sensor, kept by reference
+ *
+ * @param[in] step_cb
+ *  Callback code scheduled when a sequence can continue. Its handler must call
+ *  sensor_step().
+ ******************************************************************************/
+void sensor_open(SENSOR_STRUCT *sensor, const SENSOR_DESCRIPTOR_STRUCT *desc, uint32_t step_cb) {
+  EFM_ASSERT(step_cb);
+  if (desc->startup_time > startup_time) {
+      startup_time = desc->startup_time;
+  }
+
+  sensor->desc = desc;
+  sensor->sequence = NULL;
+  sensor->step = NULL;
+  sensor->step_cb = step_cb;
+  sensor->done_cb = 0x00;
+  sensor->busy = false;
+  sensor->status = I2C_STATUS_OK;
+
+  if (bus_opened[desc->which_i2c]) {
+      return;
+  }
+
+  I2C_OPEN_STRUCT i2c_config;
+  i2c_config.master = true;
+  i2c_config.enable = true;
+  i2c_config.freq = I2C_FREQ_FAST_MAX;
+  i2c_config.clhr = i2cClockHLRAsymetric;
+  i2c_config.scl_route_pin = I2C_BUS_SCL_ROUTE(desc->which_i2c);
+  i2c_config.sda_route_pin = I2C_BUS_SDA_ROUTE(desc->which_i2c);
+  i2c_open(I2C_BUS(desc->which_i2c), &i2c_config);
+  bus_opened[desc->which_i2c] = true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Time the opened sensors need from power-up until they answer.
+ *
+ * @return
+ *   Longest startup time of the opened sensors in ms.
+ ******************************************************************************/
+uint32_t sensor_startup_time(void) {
+  return startup_time;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a command sequence on a sensor.
+ *
+ * @details
+ *   Returns right away. The sequence runs from I2C and delay completion
+ *   events. Once its last step has finished, the done event is posted with a
+ *   message that carries the raw bytes, the status and the time the sequence
+ *   ended.
+ *
+ * @note
+ *   The sequence table is kept by reference and must stay valid while it
+ *   runs. Only one sequence can run on a sensor at a time.
+ *
+ * @param[in] sensor
+ *  Sensor to run the sequence on
+ *
+ * @param[in] sequence
+ *  Steps ended by SENSOR_END
+ *
+ * @param[in] done_cb
+ *  Callback code posted once the sequence is done. Its handler must receive
+ *  the message.
+ ******************************************************************************/
+void sensor_run(SENSOR_STRUCT *sensor, const SENSOR_STEP_STRUCT *sequence, uint32_t done_cb) {
+  EFM_ASSERT(sensor->desc);
+  EFM_ASSERT(!sensor->busy);
+
+  sensor->sequence = sequence;
+  sensor->step = sequence;
+  sensor->done_cb = done_cb;
+  sensor->busy = true;
+  sensor->status = I2C_STATUS_OK;
+  sensor_step(sensor);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Runs a sensor's sequence up to its next wait.
+ *
+ * @details
+ *   Delays are timed by the LETIMER. A delay too short for it is only skipped
+ *   if a bare read follows, whose header is NACKed and retried until the
+ *   sensor is ready. Any other short delay is timed anyway and lasts up to
+ *   LETIMER_COMP_MARGIN ticks longer, but never less. A sequence whose I2C
+ *   transfers failed ends early with its done event.
+ *
+ * @note
+ *   This function should be called from the handler of the sensor's step
+ *   callback.
+ *
+ * @param[in] sensor
+ *  Sensor whose sequence is running
+ ******************************************************************************/
+void sensor_step(SENSOR_STRUCT *sensor) {
+  EFM_ASSERT(sensor->busy);
+
+  if (sensor->status != I2C_STATUS_OK) {
+      sensor_done(sensor, SENSOR_STATUS_BUS_ERROR);
+      return;
+  }
+
+  while (true) {
+      const SENSOR_STEP_STRUCT *step = sensor->step;
+      switch (step->type) {
+        case SENSOR_STEP_END:
+          sensor_done(sensor, sensor_check(sensor));
+          return;
+        case SENSOR_STEP_DELAY:
+          sensor->step++;
+          if (step->delay > LETIMER_COMP_MARGIN || !sensor_polls(sensor->step)) {
+              timer_delay_async(step->delay, sensor->step_cb);
+              return;
+          }
+          break;
+        case SENSOR_STEP_WRITE:
+        case SENSOR_STEP_READ:
+          sensor_start_transfers(sensor);
+          return;
+        default:
+          EFM_ASSERT(false);
+          return;
+      }
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Decodes a reading from the message of a sequence's done event.
+ *
+ * @details
+ *   The reading is decoded by the sensor's decode function if the sequence
+ *   finished without bus errors and its checksums matched.
+ *
+ * @note
+ *   This function should be called from the done event's handler.
+ *
+ * @param[in] sensor
+ *  Sensor the message came from
+ *
+ * @param[in] message
+ *  Message received for the done event
+ *
+ * @param[out] reading
+ *  Decoded reading, left untouched if the sequence failed
+ *
+ * @return
+ *   True if the reading is valid.
+ ******************************************************************************/
+bool sensor_get_reading(const SENSOR_STRUCT *sensor, const SCHEDULER_MESSAGE_STRUCT *message, SENSOR_READING_STRUCT *reading) {
+  if (message->status != SENSOR_STATUS_OK) {
+      return false;
+  }
+  sensor->desc->decode(message->payload, reading);
+  return true;
+}
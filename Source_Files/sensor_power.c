@@ -0,0 +1,214 @@
+/*****************************************************
+ * @file sensor_power.c
+ * @author Branson Camp
+ * @date 12/09/2022
+ * @brief Powers the sensors and their I2C pins only
+ * while a sample is being taken.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "sensor_power.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+typedef enum {
+  sensor_power_off,
+  sensor_power_powering, // Waiting for the power-up time
+  sensor_power_on,
+} SENSOR_POWER_STATES;
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static SENSOR_POWER_STATES power_state;
+static uint32_t power_users; // Acquisitions not released yet
+static uint32_t power_waiting; // Ready events to schedule once powered up
+static uint32_t power_step_cb; // Event scheduled when the power-up time is over
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void sensor_power_pins(bool on);
+
+/***************************************************************************//**
+ * @brief
+ *   Switches the sensor supply and the I2C pins.
+ *
+ * @details
+ *   Powered down, the sensor enable pin is driven low and the SDA and SCL pins
+ *   of both buses are disabled so no current flows through the pull-ups. On
+ *   power-up the pins are handed back to the I2C peripherals.
+ *
+ * @param[in] on
+ *  True to power up, false to power down
+ ******************************************************************************/
+static void sensor_power_pins(bool on) {
+  if (on) {
+      GPIO_PinOutSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN);
+      GPIO_PinModeSet(SI7021_SCL_PORT, SI7021_SCL_PIN, SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
+      GPIO_PinModeSet(SI7021_SDA_PORT, SI7021_SDA_PIN, SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
+      GPIO_PinModeSet(SHTC3_SCL_PORT, SHTC3_SCL_PIN, SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
+      GPIO_PinModeSet(SHTC3_SDA_PORT, SHTC3_SDA_PIN, SI7021_SENSOR_CONFIG, SI7021_SENSOR_DEFAULT);
+  } else {
+      GPIO_PinModeSet(SI7021_SCL_PORT, SI7021_SCL_PIN, gpioModeDisabled, 0);
+      GPIO_PinModeSet(SI7021_SDA_PORT, SI7021_SDA_PIN, gpioModeDisabled, 0);
+      GPIO_PinModeSet(SHTC3_SCL_PORT, SHTC3_SCL_PIN, gpioModeDisabled, 0);
+      GPIO_PinModeSet(SHTC3_SDA_PORT, SHTC3_SDA_PIN, gpioModeDisabled, 0);
+      GPIO_PinOutClear(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN);
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Initializes the sensor power manager and powers the sensors up.
+ *
+ * @details
+ *   The sensors are powered up at once and held for the bring-up, so they
+ *   start up while the other peripherals are opened. The power-up time is
+ *   timed by sensor_power_boot() once the LETIMER runs. The bring-up must
+ *   call sensor_power_release() once it is done.
+ *
+ * @note
+ *   This function should be called right after gpio_open, as early as
+ *   possible.
+ *
+ * @param[in] step_cb
+ *  Callback code scheduled when the power-up time is over. Its handler must
+ *  call sensor_power_step().
+ ******************************************************************************/
+void sensor_power_open(uint32_t step_cb) {
+  power_step_cb = step_cb;
+  power_waiting = 0;
+  power_users = 1;
+  power_state = sensor_power_powering;
+  GPIO_PinOutSet(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Waits out the power-up of sensor_power_open() without blocking.
+ *
+ * @details
+ *   The ready event of the bring-up is scheduled once startup_ms has passed,
+ *   together with any acquisition made in the meantime. The time counts from
+ *   this call, not from power-up, so the time spent opening the peripherals
+ *   since sensor_power_open() adds to the wait. The sensors are then ready
+ *   a little later than they need to be, never too early.
+ *
+ * @note
+ *   This function should be called once, after timer_delay_open() and the
+ *   sensor drivers have been opened.
+ *
+ * @param[in] ready_cb
+ *  Callback code scheduled once the sensors can be used
+ *
+ * @param[in] startup_ms
+ *  Time the sensors need from power-up until they answer
+ ******************************************************************************/
+void sensor_power_boot(uint32_t ready_cb, uint32_t startup_ms) {
+  EFM_ASSERT(power_state == sensor_power_powering);
+  power_waiting |= ready_cb;
+  timer_delay_async(startup_ms, power_step_cb);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Requests power for a sensor transaction.
+ *
+ * @details
+ *   If the sensors are powered, the ready event is scheduled right away.
+ *   Otherwise the sensors are powered up and the ready event is scheduled once
+ *   the power-up time is over. Every call must be matched by a call to
+ *   sensor_power_release().
+ *
+ * @note
+ *   This function should be called from the scheduler, not from interrupts.
+ *
+ * @param[in] ready_cb
+ *  Callback code scheduled once the sensors can be used
+ ******************************************************************************/
+void sensor_power_acquire(uint32_t ready_cb) {
+  power_users++;
+  switch (power_state) {
+    case sensor_power_on:
+      add_scheduled_event(ready_cb);
+      break;
+    case sensor_power_powering:
+      power_waiting |= ready_cb;
+      break;
+    case sensor_power_off:
+      power_state = sensor_power_powering;
+      power_waiting = ready_cb;
+      sensor_power_pins(true);
+      timer_delay_async(SENSOR_POWER_UP_TIME, power_step_cb);
+      break;
+    default:
+      EFM_ASSERT(false);
+      break;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Ends a sensor transaction.
+ *
+ * @details
+ *   Once every acquisition has been released, the sensors and their I2C pins
+ *   are powered down until the next acquisition.
+ *
+ * @note
+ *   Both I2C buses must be idle when the last acquisition is released. The
+ *   drivers schedule their completion events from the stop condition, so
+ *   calling this function from a completion handler is safe.
+ ******************************************************************************/
+void sensor_power_release(void) {
+  EFM_ASSERT(power_users > 0);
+  EFM_ASSERT(power_state == sensor_power_on);
+
+  power_users--;
+  if (power_users == 0) {
+      power_state = sensor_power_off;
+      sensor_power_pins(false);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Continues a power-up once the power-up time is over.
+ *
+ * @details
+ *   Resets both I2C buses, which could not see the bus while their pins were
+ *   disabled, then schedules the ready events of every acquisition made while
+ *   powering up. The reset waits until now so the bus lines have settled.
+ *
+ * @note
+ *   This function should be called by the handler of the step_cb event.
+ ******************************************************************************/
+void sensor_power_step(void) {
+  EFM_ASSERT(power_state == sensor_power_powering);
+
+  i2c_reset(I2C0);
+  i2c_reset(I2C1);
+  power_state = sensor_power_on;
+  add_scheduled_event(power_waiting);
+  power_waiting = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Returns whether the sensors are powered and ready.
+ *
+ * @return
+ *   True if the sensors can be used.
+ ******************************************************************************/
+bool sensor_power_is_on(void) {
+  return power_state == sensor_power_on;
+}
@@ -7,76 +7,81 @@
 
 #include "shtc3.h"
 
-static uint32_t output_bytes;
+static void shtc3_decode(const uint8_t *raw, SENSOR_READING_STRUCT *reading);
+
+static const SENSOR_DESCRIPTOR_STRUCT shtc3_desc = {
+  .which_i2c = SHTC3_WHICH_I2C,
+  .device_address = SHTC3_DEVICE_ADDRESS,
+  .startup_time = SHTC3_STARTUP_TIME,
+  .crc_init = SHTC3_CRC_INIT,
+  .decode = shtc3_decode,
+};
+
+// Every read wakes the SHTC3 up, measures and puts it back to sleep. Without
+// clock stretching the bus is released during the conversion and the data is
+// read once the conversion time has passed. The low power conversion is too
+// short for the LETIMER, its read is NACKed until the SHTC3 is done. The
+// wake-up delay is always timed, a command sent before it would be NACKed.
+static const SENSOR_STEP_STRUCT shtc3_measure_normal[] = {
+  SENSOR_WRITE(SHTC3_WAKEUP_CMD, 2, NULL, 0),
+  SENSOR_DELAY(SHTC3_WAKEUP_TIME),
+  SENSOR_WRITE(SHTC3_MEASURE_NORMAL, 2, NULL, 0),
+  SENSOR_DELAY(SHTC3_NORMAL_MEASURE_TIME),
+  SENSOR_READ(0x00, 0, SHTC3_MEASURE_BYTES, 0, true),
+  SENSOR_WRITE(SHTC3_SLEEP_CMD, 2, NULL, 0),
+  SENSOR_END,
+};
+
+static const SENSOR_STEP_STRUCT shtc3_measure_normal_stretch[] = {
+  SENSOR_WRITE(SHTC3_WAKEUP_CMD, 2, NULL, 0),
+  SENSOR_DELAY(SHTC3_WAKEUP_TIME),
+  SENSOR_READ(SHTC3_MEASURE_NORMAL_STRETCH, 2, SHTC3_MEASURE_BYTES, 0, true),
+  SENSOR_WRITE(SHTC3_SLEEP_CMD, 2, NULL, 0),
+  SENSOR_END,
+};
+
+static const SENSOR_STEP_STRUCT shtc3_measure_lp[] = {
+  SENSOR_WRITE(SHTC3_WAKEUP_CMD, 2, NULL, 0),
+  SENSOR_DELAY(SHTC3_WAKEUP_TIME),
+  SENSOR_WRITE(SHTC3_MEASURE_LP, 2, NULL, 0),
+  SENSOR_DELAY(SHTC3_LP_MEASURE_TIME),
+  SENSOR_READ(0x00, 0, SHTC3_MEASURE_BYTES, 0, true),
+  SENSOR_WRITE(SHTC3_SLEEP_CMD, 2, NULL, 0),
+  SENSOR_END,
+};
+
+static const SENSOR_STEP_STRUCT shtc3_measure_lp_stretch[] = {
+  SENSOR_WRITE(SHTC3_WAKEUP_CMD, 2, NULL, 0),
+  SENSOR_DELAY(SHTC3_WAKEUP_TIME),
+  SENSOR_READ(SHTC3_MEASURE_LP_STRETCH, 2, SHTC3_MEASURE_BYTES, 0, true),
+  SENSOR_WRITE(SHTC3_SLEEP_CMD, 2, NULL, 0),
+  SENSOR_END,
+};
+
+static SENSOR_STRUCT shtc3;
+static const SENSOR_STEP_STRUCT *shtc3_measure = shtc3_measure_normal;
 
 /***************************************************************************//**
  * @brief
- *   General helper function for writing data using I2C.
+ *   Converts the raw bytes of a measurement.
  *
  * @details
- *   Uses I2C to write data of a given number of bytes to the SHTC3.
+ *   The SHTC3 gives a six byte response, temperature then relative humidity,
+ *   each followed by its checksum. Uses the formulas defined in the SHTC3
+ *   manual, T = -45 + 175 * code / 65536 and RH = 100 * code / 65536, scaled
+ *   by 100 using an integer multiply and shift.
  *
- * @note
- *   This function should only be called by functions in this file.
- *
- * @param[in] data
- *   Data to write (maximum 4 bytes at a time).
+ * @param[in] raw
+ *   Bytes read by a measure sequence
  *
- * @param[in] num_bytes
- *   Number of bytes of data to be written.
+ * @param[out] reading
+ *   Decoded reading
  ******************************************************************************/
-static void shtc3_i2c_write(uint32_t data, uint32_t num_bytes) {
-  I2C_START_STRUCT i2c_start_struct;
-  i2c_start_struct.which_i2c = 1;
-  i2c_start_struct.comm_method = I2C_WRITE;
-  i2c_start_struct.device_address = SHTC3_DEVICE_ADDRESS;
-  i2c_start_struct.register_address = 0x00;
-  i2c_start_struct.num_bytes = num_bytes;
-  i2c_start_struct.finished_callback = 0x00;
-  i2c_start_struct.data = &data;
-  i2c_start_struct.num_register_bytes = 0;
-
-  i2c_start(&i2c_start_struct);
-  timer_delay(10);
-}
-
-/***************************************************************************//**
- * @brief
- *   General helper function for reading data using I2C.
- *
- * @details
- *   Uses I2C to read data of a given number of bytes from the SHTC3.
- *
- * @note
- *   This function should only be called by functions in this file.
- *
- * @param[in] data
- *   Pointer to deposit the data upon successful read.
- *
- * @param[in] data_bytes
- *   Number of bytes expected to be read from the SHTC3
- *
- * @param[in] command
- *   Command to initiate the reading (AKA the register address).
- *
- * @param[in] cb
- *   Callback code referenced upon successful read completion
- *
- * @param[in] num_register_bytes
- *   Number of bytes in the command to write (AKA the register address).
- ******************************************************************************/
-static void shtc3_i2c_read(uint32_t* data, uint32_t data_bytes, uint32_t command, uint32_t cb, uint32_t num_register_bytes) {
-  I2C_START_STRUCT i2c_start_struct;
-  i2c_start_struct.which_i2c = 1;
-  i2c_start_struct.comm_method = I2C_READ;
-  i2c_start_struct.device_address = SHTC3_DEVICE_ADDRESS;
-  i2c_start_struct.register_address = command;
-  i2c_start_struct.num_bytes = data_bytes;
-  i2c_start_struct.finished_callback = cb;
-  i2c_start_struct.data = data;
-  i2c_start_struct.num_register_bytes = num_register_bytes;
-  i2c_start(&i2c_start_struct);
-  timer_delay(10);
+static void shtc3_decode(const uint8_t *raw, SENSOR_READING_STRUCT *reading) {
+  reading->temp_raw = (raw[0] << 8) | raw[1];
+  reading->humidity_raw = (raw[3] << 8) | raw[4];
+  reading->temp = (int32_t)((SHTC3_TEMP_GAIN * reading->temp_raw) >> 16) + SHTC3_TEMP_OFFSET;
+  reading->humidity = (int32_t)((SHTC3_HUM_GAIN * reading->humidity_raw) >> 16) + SHTC3_HUM_OFFSET;
 }
 
 /***************************************************************************//**
@@ -84,65 +89,44 @@ static void shtc3_i2c_read(uint32_t* data, uint32_t data_bytes, uint32_t command
  *   Configures and opens the I2C peripheral to allow communication.
  *
  * @details
- *   Configures the chosen I2C peripheral to begin communication with the SHTC3.
+ *   Opens the SHTC3 and its I2C bus through the sensor engine.
  *
  * @note
  *   This function should be called before doing any read or writes with the SHTC3.
+ *
+ * @param[in] step_cb
+ *   Callback code scheduled when a read can continue. Its handler must call
+ *   shtc3_step().
  ******************************************************************************/
-void shtc3_i2c_open() {
-  timer_delay(SHTC3_STARTUP_TIME);
-
-  I2C_OPEN_STRUCT i2c_config;
-
-  i2c_config.master = true;
-  i2c_config.enable = true;
-  i2c_config.freq = I2C_FREQ_FAST_MAX;
-  i2c_config.clhr = i2cClockHLRAsymetric;
-  i2c_config.scl_route_pin = I2C1_SCL_ROUTE;
-  i2c_config.sda_route_pin = I2C1_SDA_ROUTE;
-
-  i2c_open(I2C1, &i2c_config);
+void shtc3_i2c_open(uint32_t step_cb) {
+  sensor_open(&shtc3, &shtc3_desc, step_cb);
 }
 
 /***************************************************************************//**
  * @brief
- *   Separates the read bytes into the temperature and humidity chunks.
+ *   Selects the measurement mode used by shtc3_read_data_and_crc().
  *
  * @details
- *   The SHTC3 gives a six byte response. This function assigns the correct
- *   bytes to temperature and relative humidity.
+ *   Low power mode trades repeatability for a conversion time below 1 ms
+ *   instead of about 12 ms. With clock stretching the SHTC3 holds SCL low
+ *   until the conversion is done. Without it the bus is released and the
+ *   data is read once the conversion time has passed.
  *
  * @note
- *   This function should be called once the raw SHTC3 response has been sent.
+ *   The new mode is used from the next read on.
  *
- * @param[in] t
- *   Pointer to temperature bytes to be deposited.
+ * @param[in] power
+ *   SHTC3_POWER_NORMAL or SHTC3_POWER_LOW.
  *
- * @param[in] t_crc
- *   Pointer to temperature checksum byte to be deposited.
- *
- * @param[in] rh
- *   Pointer to relative humidity bytes to be deposited.
- *
- * @param[in] rh_crc
- *   Pointer to relative humidity checksum byte to be deposited.
+ * @param[in] clock_stretch
+ *   True to let the SHTC3 stretch the clock during the conversion.
  ******************************************************************************/
-static void parse_data(uint32_t* t, uint32_t* t_crc, uint32_t* rh, uint32_t* rh_crc) {
-  CORE_DECLARE_IRQ_STATE;
-  CORE_ENTER_CRITICAL();
-  const uint32_t num_bytes = 6;
-  uint32_t bytes[6];
-
-  for (int i = 0; i < num_bytes; i++) {
-      bytes[i] = (output_bytes >> (8*i)) & 0xff;
+void shtc3_set_measure_mode(SHTC3_POWER_TypeDef power, bool clock_stretch) {
+  if (power == SHTC3_POWER_LOW) {
+      shtc3_measure = clock_stretch ? shtc3_measure_lp_stretch : shtc3_measure_lp;
+  } else {
+      shtc3_measure = clock_stretch ? shtc3_measure_normal_stretch : shtc3_measure_normal;
   }
-
-  *t = (bytes[0] << 8) | bytes[1];
-  *t_crc = bytes[2];
-
-  *rh = (bytes[3] << 8) | bytes[4];
-  *rh_crc = bytes[5];
-  CORE_EXIT_CRITICAL();
 }
 
 /***************************************************************************//**
@@ -150,8 +134,9 @@ static void parse_data(uint32_t* t, uint32_t* t_crc, uint32_t* rh, uint32_t* rh_
  *   Reads the data and checksums of temperature and humidity using I2C
  *
  * @details
- *   Starts three separate I2C operations to handle the demands of the
- *   SHTC3. Uses the callback once complete.
+ *   Starts the measure sequence of the selected mode without blocking. Each
+ *   following step is started by shtc3_step(). Uses the callback once the data
+ *   has been read and the SHTC3 has been put back to sleep.
  *
  * @note
  *   This function should be called after calling shtc3_i2c_open()
@@ -160,85 +145,42 @@ static void parse_data(uint32_t* t, uint32_t* t_crc, uint32_t* rh, uint32_t* rh_
  *   Callback code for completion of acquiring the data.
  ******************************************************************************/
 void shtc3_read_data_and_crc(uint32_t cb) {
-  // Wake up command
-  shtc3_i2c_write(SHTC3_WAKEUP_CMD, 2);
-  timer_delay(SHTC3_STARTUP_TIME);
-
-  // Measure command
-  output_bytes = 0;
-  shtc3_i2c_read(&output_bytes, 6, SHTC3_MEASURE_CMD_T_FIRST, cb, 2);
-
-  // Sleep command
-  shtc3_i2c_write(SHTC3_SLEEP_CMD, 2);
+  sensor_run(&shtc3, shtc3_measure, cb);
 }
 
 /***************************************************************************//**
  * @brief
- *   Calculates the temperature as degrees Fahrenheit.
- *
- * @details
- *   Once the raw data has been attained, this function uses the formulas
- *   defined in the SHTC3 manual to obtain a temperature in degrees F.
+ *   Continues a read once its previous step has completed.
  *
  * @note
- *   This function should be called after calling shtc3_read_data_and_crc().
- *
- * @return
- *   The temperature in degrees Fahrenheit.
+ *   This function should be called from the handler of the step callback
+ *   passed to shtc3_i2c_open().
  ******************************************************************************/
-static float shtc3_calc_temp() {
-  uint32_t t, t_crc, rh, rh_crc;
-  parse_data(&t, &t_crc, &rh, &rh_crc);
-
-  float fraction = ((float) t) / (65536.0);
-
-  return -45.0 + (175.0 * fraction);
+void shtc3_step(void) {
+  sensor_step(&shtc3);
 }
 
 /***************************************************************************//**
  * @brief
- *   Calculates the relative humidity as a percent (%).
+ *   Gets the temperature and humidity reading carried by a read's message.
  *
  * @details
- *   Once the raw data has been attained, this function uses the formulas
- *   defined in the SHTC3 manual to obtain the relative humidity as a percent (%).
+ *   Temperature is in hundredths of a degree Celcius and humidity in
+ *   hundredths of a percent. The raw codes are returned along with them.
  *
  * @note
- *   This function should be called after calling shtc3_read_data_and_crc().
+ *   This function should be called from the handler of the callback passed
+ *   to shtc3_read_data_and_crc, with the message received for it.
  *
- * @return
- *   The relative humidity as a percent (%).
- ******************************************************************************/
-static float shtc3_calc_hum() {
-    uint32_t t, t_crc, rh, rh_crc;
-    parse_data(&t, &t_crc, &rh, &rh_crc);
-
-    float fraction = ((float) rh) / (65536.0);
-
-    return 100.0 * fraction;
-}
-
-/***************************************************************************//**
- * @brief
- *   Gets the temperature (F) and humidity (%) and drops them into pointers
- *   of your choosing.
- *
- * @details
- *   Uses shtc3_calc_temp() and shtc3_calc_hum() to fetch both results at once.
- *
- * @note
- *   This function should be used after shtc3_read_data_and_crc has been called
- *   and has been completed successfully.
+ * @param[in] message
+ *   Message received for the read's callback
  *
- * @param[in] temp
- *   Temperature pointer for temperature value to be deposited.
+ * @param[out] reading
+ *   Decoded reading, left untouched if the read failed
  *
- * @param[in] hum
- *   Humidity pointer for humidity value to be deposited.
+ * @return
+ *   True if the read finished and passed its checksums.
  ******************************************************************************/
-void shtc3_app_get_temp_and_hum(float* temp, float* hum) {
-  *temp = shtc3_calc_temp();
-  *hum = shtc3_calc_hum();
+bool shtc3_get_reading(const SCHEDULER_MESSAGE_STRUCT *message, SENSOR_READING_STRUCT *reading) {
+  return sensor_get_reading(&shtc3, message, reading);
 }
-
-
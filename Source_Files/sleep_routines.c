@@ -34,9 +34,70 @@
 **************************************************************************/
 
 #include "sleep_routines.h"
+#ifdef SLEEP_PROFILE
+#include "em_cmu.h"
+#include "letimer.h"
+#endif
 
 static int lowest_energy_mode[MAX_ENERGY_MODES];
 
+#ifdef SLEEP_PROFILE
+static SLEEP_PROFILE_STRUCT sleep_profile;
+static uint64_t timer_residency[EM2]; // SLEEP_PROFILE_TIMER counts spent in EM0 and EM1
+static uint64_t letimer_residency[MAX_ENERGY_MODES]; // LETIMER ticks spent in EM2 and EM3
+static uint32_t awake_since; // SLEEP_PROFILE_TIMER count of the last wake up
+#endif
+
+/***************************************************************************//**
+ * @brief
+ *   Enters a sleep mode and waits for the wake up.
+ *
+ * @details
+ *   In a SLEEP_PROFILE build, the time spent awake before sleeping and the
+ *   time spent asleep are added to the mode's residency. EM0 and EM1 keep the
+ *   HF clocks running, so they are timed with SLEEP_PROFILE_TIMER. Its clock
+ *   stops in EM2 and EM3, which are timed with the LETIMER0 tick count
+ *   instead.
+ *
+ * @note
+ *   This function should be called from inside a critical section. EM2 and
+ *   EM3 sleeps shorter than a LETIMER tick are counted as wakes with no
+ *   residency.
+ *
+ * @param[in] EM
+ *   Energy mode to enter, EM1 to EM3
+ *
+ ******************************************************************************/
+static void sleep_enter_mode(uint32_t EM) {
+#ifdef SLEEP_PROFILE
+  uint32_t sleep_start = SLEEP_PROFILE_TIMER->CNT;
+  uint32_t sleep_start_ticks = letimer_get_ticks(LETIMER0);
+  timer_residency[EM0] += sleep_start - awake_since;
+#endif
+
+  switch (EM) {
+    case EM1:
+      EMU_EnterEM1();
+      break;
+    case EM2:
+      EMU_EnterEM2(true);
+      break;
+    default:
+      EMU_EnterEM3(true);
+      break;
+  }
+
+#ifdef SLEEP_PROFILE
+  awake_since = SLEEP_PROFILE_TIMER->CNT;
+  if (EM == EM1) {
+      timer_residency[EM1] += awake_since - sleep_start;
+  } else {
+      letimer_residency[EM] += letimer_get_ticks(LETIMER0) - sleep_start_ticks;
+  }
+  sleep_profile.wakes[EM]++;
+#endif
+}
+
 /***************************************************************************//**
  * @brief
  *   Initializes this module.
@@ -56,6 +117,13 @@ void sleep_open() {
       lowest_energy_mode[i] = 0;
   }
   CORE_EXIT_CRITICAL();
+#ifdef SLEEP_PROFILE
+  CMU_ClockEnable(SLEEP_PROFILE_CLOCK, true);
+  TIMER_Init_TypeDef timer_init = TIMER_INIT_DEFAULT; // Free running up count
+  timer_init.prescale = SLEEP_PROFILE_PRESCALE;
+  TIMER_Init(SLEEP_PROFILE_TIMER, &timer_init);
+  sleep_profile_reset();
+#endif
 }
 
 /***************************************************************************//**
@@ -72,11 +140,18 @@ void sleep_open() {
  * @param[in] EM
  *   Desired energy mode to unblock
  *
+ * @param[in] caller
+ *   Blocker taking the block, counted in a SLEEP_PROFILE build
+ *
  ******************************************************************************/
-void sleep_block_mode(uint32_t EM) {
+void sleep_block_mode(uint32_t EM, SLEEP_CALLER_TypeDef caller) {
+  EFM_ASSERT(caller < SLEEP_NUM_CALLERS);
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
   lowest_energy_mode[EM]++;
+#ifdef SLEEP_PROFILE
+  sleep_profile.blocks[caller]++;
+#endif
   CORE_EXIT_CRITICAL();
   EFM_ASSERT (lowest_energy_mode[EM] < 5);
 }
@@ -94,11 +169,18 @@ void sleep_block_mode(uint32_t EM) {
  * @param[in] EM
  *   Desired energy mode to unblock
  *
+ * @param[in] caller
+ *   Blocker that took the block, counted in a SLEEP_PROFILE build
+ *
  ******************************************************************************/
-void sleep_unblock_mode(uint32_t EM) {
+void sleep_unblock_mode(uint32_t EM, SLEEP_CALLER_TypeDef caller) {
+  EFM_ASSERT(caller < SLEEP_NUM_CALLERS);
   CORE_DECLARE_IRQ_STATE;
   CORE_ENTER_CRITICAL();
   lowest_energy_mode[EM]--;
+#ifdef SLEEP_PROFILE
+  sleep_profile.unblocks[caller]++;
+#endif
   CORE_EXIT_CRITICAL();
   EFM_ASSERT (lowest_energy_mode[EM] >= 0);
 }
@@ -128,18 +210,18 @@ void enter_sleep() {
   }
 
   if (lowest_energy_mode[EM2]) {
-      EMU_EnterEM1();
+      sleep_enter_mode(EM1);
       CORE_EXIT_CRITICAL();
       return;
   }
 
   if (lowest_energy_mode[EM3]) {
-      EMU_EnterEM2(true);
+      sleep_enter_mode(EM2);
       CORE_EXIT_CRITICAL();
       return;
   }
 
-  EMU_EnterEM3(true);
+  sleep_enter_mode(EM3);
   CORE_EXIT_CRITICAL();
   return;
 }
@@ -175,3 +257,68 @@ uint32_t current_block_energy_mode(void) {
   return selected_em;
 }
 
+
+#ifdef SLEEP_PROFILE
+/***************************************************************************//**
+ * @brief
+ *   Copies the energy mode profile.
+ *
+ * @details
+ *   The residency of EM0 is brought up to date first, so the profile covers
+ *   the time up to this call. Block and unblock counts per caller show which
+ *   blocker held the core awake, such as an I2C bus or the LETIMER.
+ *
+ * @note
+ *   Only available in a SLEEP_PROFILE build. This function can be called at
+ *   any time.
+ *
+ * @param[out] profile
+ *   Struct the profile is copied into
+ *
+ ******************************************************************************/
+void sleep_profile_get(SLEEP_PROFILE_STRUCT *profile) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  uint32_t now = SLEEP_PROFILE_TIMER->CNT;
+  timer_residency[EM0] += now - awake_since;
+  awake_since = now;
+
+  uint32_t counts_per_us = CMU_ClockFreqGet(SLEEP_PROFILE_CLOCK) / SLEEP_PROFILE_DIVISOR / 1000000u;
+  for (int i = 0; i < MAX_ENERGY_MODES; i++) {
+      sleep_profile.residency_us[i] = i < EM2 ? timer_residency[i] / counts_per_us
+          : letimer_residency[i] * (1000000u / LETIMER_HZ);
+  }
+  *profile = sleep_profile;
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Clears the energy mode profile.
+ *
+ * @details
+ *   Starts a new measurement window from this call.
+ *
+ * @note
+ *   Only available in a SLEEP_PROFILE build. This function can be called at
+ *   any time.
+ *
+ ******************************************************************************/
+void sleep_profile_reset(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  for (int i = 0; i < MAX_ENERGY_MODES; i++) {
+      letimer_residency[i] = 0;
+      sleep_profile.wakes[i] = 0;
+  }
+  for (int i = 0; i < EM2; i++) {
+      timer_residency[i] = 0;
+  }
+  for (int i = 0; i < SLEEP_NUM_CALLERS; i++) {
+      sleep_profile.blocks[i] = 0;
+      sleep_profile.unblocks[i] = 0;
+  }
+  awake_since = SLEEP_PROFILE_TIMER->CNT;
+  CORE_EXIT_CRITICAL();
+}
+#endif
@@ -0,0 +1,224 @@
+/*****************************************************
+ * @file swtimer.c
+ * @author Branson Camp
+ * @date 12/14/2022
+ * @brief Runs any number of one-shot and periodic
+ * software timers on LETIMER0 COMP1.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "swtimer.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+static SWTIMER_STRUCT *timer_list; // Active timers, earliest deadline first
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void swtimer_insert(SWTIMER_STRUCT *timer);
+static void swtimer_unlink(SWTIMER_STRUCT *timer);
+static void swtimer_arm(void);
+
+/***************************************************************************//**
+ * @brief
+ *   Inserts a timer into the deadline list, behind timers that expire at the
+ *   same tick.
+ *
+ * @note
+ *   Called with interrupts off.
+ *
+ * @param[in] timer
+ *  Timer with its deadline set
+ ******************************************************************************/
+static void swtimer_insert(SWTIMER_STRUCT *timer) {
+  SWTIMER_STRUCT **link = &timer_list;
+  while (*link && (int32_t)((*link)->deadline - timer->deadline) <= 0) {
+      link = &(*link)->next;
+  }
+  timer->next = *link;
+  *link = timer;
+  timer->active = true;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Removes a timer from the deadline list.
+ *
+ * @note
+ *   Called with interrupts off.
+ *
+ * @param[in] timer
+ *  Active timer
+ ******************************************************************************/
+static void swtimer_unlink(SWTIMER_STRUCT *timer) {
+  SWTIMER_STRUCT **link = &timer_list;
+  while (*link && *link != timer) {
+      link = &(*link)->next;
+  }
+  if (*link) {
+      *link = timer->next;
+  }
+  timer->next = NULL;
+  timer->active = false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Arms COMP1 for the earliest deadline, or disables it if no timer is
+ *   active.
+ *
+ * @note
+ *   Called with interrupts off.
+ ******************************************************************************/
+static void swtimer_arm(void) {
+  if (timer_list) {
+      letimer_comp1_deadline(LETIMER0, timer_list->deadline);
+  } else {
+      letimer_comp1_cancel(LETIMER0);
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Clears all timers.
+ *
+ * @details
+ *   Timers run on LETIMER0 COMP1, so the LETIMER must be opened and started
+ *   before a timer is started. No periodic tick is used: COMP1 only fires at
+ *   the earliest deadline, and at underflows of periods it does not fall in.
+ *
+ * @note
+ *   This function should be called once before swtimer_start().
+ ******************************************************************************/
+void swtimer_open(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  timer_list = NULL;
+  letimer_comp1_cancel(LETIMER0);
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts, or restarts, a timer.
+ *
+ * @details
+ *   The callback is scheduled delay_ms from now, then every period_ms if the
+ *   period is not 0. Periodic deadlines advance by whole periods, so they do
+ *   not drift with the dispatch latency.
+ *
+ * @note
+ *   The timer is caller-owned and must stay valid while it is active. It may
+ *   be expired up to LETIMER_COMP_MARGIN ticks late but never early.
+ *
+ * @param[in] timer
+ *  Timer to start
+ *
+ * @param[in] delay_ms
+ *  Milliseconds to the first expiry
+ *
+ * @param[in] period_ms
+ *  Milliseconds between later expiries, 0 for a one-shot timer
+ *
+ * @param[in] cb
+ *  Event scheduled on every expiry
+ ******************************************************************************/
+void swtimer_start(SWTIMER_STRUCT *timer, uint32_t delay_ms, uint32_t period_ms, uint32_t cb) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if (timer->active) {
+      swtimer_unlink(timer);
+  }
+  timer->deadline = letimer_get_ticks(LETIMER0) + (delay_ms * LETIMER_HZ) / 1000;
+  timer->period = (period_ms * LETIMER_HZ) / 1000;
+  timer->cb = cb;
+  swtimer_insert(timer);
+  swtimer_arm();
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Stops a timer.
+ *
+ * @details
+ *   An expiry that has already been scheduled is not taken back.
+ *
+ * @param[in] timer
+ *  Timer to stop, may already be stopped
+ ******************************************************************************/
+void swtimer_cancel(SWTIMER_STRUCT *timer) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if (timer->active) {
+      swtimer_unlink(timer);
+      swtimer_arm();
+  }
+  CORE_EXIT_CRITICAL();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Tells whether a timer is started.
+ *
+ * @param[in] timer
+ *  Timer to check
+ *
+ * @return
+ *   True until a one-shot timer expires or the timer is canceled.
+ ******************************************************************************/
+bool swtimer_active(const SWTIMER_STRUCT *timer) {
+  return timer->active;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Schedules the events of all expired timers and arms the next deadline.
+ *
+ * @details
+ *   Expired one-shot timers are stopped. Periodic timers move on to their
+ *   next deadline, skipping the ones that have already passed. The skipped
+ *   deadlines are whole periods, so a late interrupt does not shift the
+ *   later ones.
+ *
+ * @note
+ *   This function is called from the LETIMER0 COMP1 and underflow interrupts,
+ *   and when the LETIMER0 period changes.
+ ******************************************************************************/
+void swtimer_expire(void) {
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  uint32_t now = letimer_get_ticks(LETIMER0);
+
+  while (timer_list && (int32_t)(timer_list->deadline - now) <= 0) {
+      SWTIMER_STRUCT *timer = timer_list;
+      swtimer_unlink(timer);
+      add_scheduled_event(timer->cb);
+
+      if (timer->period) {
+          timer->deadline += timer->period;
+          if ((int32_t)(timer->deadline - now) <= 0) {
+              // Skip the missed periods but keep the timer's phase
+              timer->deadline += timer->period * ((now - timer->deadline) / timer->period + 1);
+          }
+          swtimer_insert(timer);
+      }
+  }
+
+  swtimer_arm();
+  CORE_EXIT_CRITICAL();
+}
@@ -0,0 +1,219 @@
+/*****************************************************
+ * @file telemetry.c
+ * @author Branson Camp
+ * @date 12/18/2022
+ * @brief Streams binary frames of the readings out of
+ * LEUART0 without waking the core per character.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#include "telemetry.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TELEMETRY_FRAME_BYTES (TELEMETRY_MAX_PAYLOAD + TELEMETRY_OVERHEAD)
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef struct {
+  uint32_t length; // Bytes of the frame
+  uint8_t bytes[TELEMETRY_FRAME_BYTES]; // Sent by LDMA straight from here
+} TELEMETRY_SLOT_STRUCT;
+
+static TELEMETRY_SLOT_STRUCT slots[TELEMETRY_FRAMES];
+static uint32_t slot_head; // Frame being sent while sending
+static uint32_t slot_count;
+static bool sending;
+static uint32_t dropped_count; // Frames refused because the queue was full
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static bool telemetry_send(TELEMETRY_FRAME_TypeDef type, const uint8_t *payload, uint32_t bytes);
+static void telemetry_start(void);
+static void telemetry_tx_done(void);
+static void telemetry_put32(uint8_t *out, uint32_t value);
+
+/***************************************************************************//**
+ * @brief
+ *   Writes a word least significant byte first.
+ ******************************************************************************/
+static void telemetry_put32(uint8_t *out, uint32_t value) {
+  out[0] = value;
+  out[1] = value >> 8;
+  out[2] = value >> 16;
+  out[3] = value >> 24;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Hands the oldest queued frame to the LEUART.
+ ******************************************************************************/
+static void telemetry_start(void) {
+  sending = true;
+  leuart_send(slots[slot_head].bytes, slots[slot_head].length, telemetry_tx_done);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Frees the frame that has been sent and starts the next one.
+ *
+ * @note
+ *   This function is called from the LEUART interrupt.
+ ******************************************************************************/
+static void telemetry_tx_done(void) {
+  slot_head = (slot_head + 1) % TELEMETRY_FRAMES;
+  slot_count--;
+  if (slot_count) {
+      telemetry_start();
+  } else {
+      sending = false;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Frames a payload into a free slot and queues it.
+ *
+ * @details
+ *   A frame is the sync byte, the type, the payload length, the payload and
+ *   a CRC-8 over the type, length and payload. The frame is built in the slot
+ *   the LDMA sends it from.
+ *
+ * @return
+ *   False if every slot is in use and the frame was dropped.
+ ******************************************************************************/
+static bool telemetry_send(TELEMETRY_FRAME_TypeDef type, const uint8_t *payload, uint32_t bytes) {
+  EFM_ASSERT(bytes <= TELEMETRY_MAX_PAYLOAD);
+
+  CORE_DECLARE_IRQ_STATE;
+  CORE_ENTER_CRITICAL();
+  if (slot_count == TELEMETRY_FRAMES) {
+      dropped_count++;
+      CORE_EXIT_CRITICAL();
+      return false;
+  }
+
+  TELEMETRY_SLOT_STRUCT *slot = &slots[(slot_head + slot_count) % TELEMETRY_FRAMES];
+  slot->bytes[0] = TELEMETRY_SYNC;
+  slot->bytes[1] = type;
+  slot->bytes[2] = bytes;
+  memcpy(&slot->bytes[3], payload, bytes);
+  slot->bytes[3 + bytes] = crc8(&slot->bytes[1], bytes + 2, TELEMETRY_CRC_INIT);
+  slot->length = bytes + TELEMETRY_OVERHEAD;
+  slot_count++;
+
+  if (!sending) {
+      telemetry_start();
+  }
+  CORE_EXIT_CRITICAL();
+  return true;
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Opens the telemetry link on LEUART0.
+ *
+ * @note
+ *   This function should be called once after cmu_open() and gpio_open().
+ ******************************************************************************/
+void telemetry_open(void) {
+  LEUART_OPEN_STRUCT leuart_config;
+  leuart_config.baudrate = TELEMETRY_BAUDRATE;
+  leuart_config.tx_route = LEUART0_TX_ROUTE;
+  leuart_config.tx_enable = true;
+  leuart_open(LEUART0, &leuart_config);
+
+  slot_head = 0;
+  slot_count = 0;
+  sending = false;
+  dropped_count = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Queues a frame with a fused estimate.
+ *
+ * @param[in] estimate
+ *  Estimate of the sample, sent as little endian words
+ *
+ * @return
+ *   False if the link is backed up and the frame was dropped.
+ ******************************************************************************/
+bool telemetry_send_estimate(const FUSION_ESTIMATE_STRUCT *estimate) {
+  uint8_t payload[TELEMETRY_ESTIMATE_BYTES];
+  telemetry_put32(&payload[0], estimate->humidity);
+  telemetry_put32(&payload[4], estimate->temp);
+  telemetry_put32(&payload[8], estimate->timestamp);
+  payload[12] = estimate->sources;
+  payload[13] = estimate->drift;
+  return telemetry_send(TELEMETRY_FRAME_ESTIMATE, payload, sizeof(payload));
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Queues a frame with a sample block.
+ *
+ * @details
+ *   The block is sent as it is stored, so the receiver decodes it like
+ *   sample_block_decode() does.
+ *
+ * @param[in] block
+ *  Block drained from the sample buffer
+ *
+ * @return
+ *   False if the link is backed up and the frame was dropped.
+ ******************************************************************************/
+bool telemetry_send_block(const SAMPLE_BLOCK *block) {
+  return telemetry_send(TELEMETRY_FRAME_BLOCK, (const uint8_t *)block, sizeof(SAMPLE_BLOCK));
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Queues a frame with an alarm transition.
+ *
+ * @param[in] event
+ *  Alarm that was raised or cleared
+ *
+ * @param[in] timestamp
+ *  Time of the sample that changed the alarm
+ *
+ * @return
+ *   False if the link is backed up and the frame was dropped.
+ ******************************************************************************/
+bool telemetry_send_alarm(const ALARM_EVENT_STRUCT *event, uint32_t timestamp) {
+  uint8_t payload[TELEMETRY_ALARM_BYTES];
+  payload[0] = event->id;
+  payload[1] = event->active;
+  telemetry_put32(&payload[2], event->value);
+  telemetry_put32(&payload[6], timestamp);
+  return telemetry_send(TELEMETRY_FRAME_ALARM, payload, sizeof(payload));
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Number of frames that can be queued before frames are dropped.
+ *
+ * @details
+ *   Producers that can hold their data back check this first.
+ ******************************************************************************/
+uint32_t telemetry_space(void) {
+  return TELEMETRY_FRAMES - slot_count;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Number of frames dropped while the link was backed up.
+ ******************************************************************************/
+uint32_t telemetry_dropped(void) {
+  return dropped_count;
+}
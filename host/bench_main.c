@@ -0,0 +1,164 @@
+/*****************************************************
+ * @file bench_main.c
+ * @author Branson Camp
+ * @date 12/16/2022
+ * @brief Runs the firmware's sample cycles on the host
+ * against the fakes and reports what each one cost.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+/* System include statements */
+#include <stdio.h>
+#include <stdlib.h>
+
+/* The developer's include statements */
+#include "app.h"
+#include "bench.h"
+#include "sample_decode.h"
+#include "fake_hw.h"
+#include "sensor_models.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define BENCH_DEFAULT_CYCLES  250 // Past the first flash log page, which fills after about 200
+#define BENCH_SHTC3_OFFSET    40  // centi, keeps the two sensors close but not equal
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// Humidity climbs through the high humidity alarm and falls back out of it
+static const SENSOR_MODEL_SAMPLE_STRUCT si7021_script[] = {
+  { 2150, 2600 }, { 2160, 2750 }, { 2170, 2900 }, { 2180, 3050 },
+  { 2190, 3200 }, { 2200, 3300 }, { 2190, 3150 }, { 2180, 2950 },
+  { 2170, 2800 }, { 2160, 2700 },
+};
+
+static SENSOR_MODEL_SAMPLE_STRUCT shtc3_script[sizeof(si7021_script) / sizeof(si7021_script[0])];
+
+static const SAMPLE_DECODE_SCALE_STRUCT scales[SAMPLE_MAX_CHANNELS] = {
+  [SAMPLE_CH_SI7021_HUM] = { SI7021_HUM_GAIN, SI7021_HUM_OFFSET },
+  [SAMPLE_CH_SI7021_TEMP] = { SI7021_TEMP_GAIN, SI7021_TEMP_OFFSET },
+  [SAMPLE_CH_SHTC3_TEMP] = { SHTC3_TEMP_GAIN, SHTC3_TEMP_OFFSET },
+  [SAMPLE_CH_SHTC3_HUM] = { SHTC3_HUM_GAIN, SHTC3_HUM_OFFSET },
+};
+
+static SENSOR_MODEL_STRUCT si7021_model;
+static SENSOR_MODEL_STRUCT shtc3_model;
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void bench_print_cycle(uint32_t cycle, const BENCH_CYCLE_STRUCT *cost, const FAKE_EMU_STRUCT *emu, const FAKE_EMU_STRUCT *last_emu) {
+  printf("cycle %3lu: isr %3lu  awake %6lu us  bus0 %5lu us  bus1 %5lu us  em0 %5llu us  em1 %6llu us  em2 %9llu us  em3 %9llu us  wakes %lu\n",
+      (unsigned long)cycle, (unsigned long)cost->isr_count, (unsigned long)cost->awake_us,
+      (unsigned long)cost->bus_busy_us[0], (unsigned long)cost->bus_busy_us[1],
+      (unsigned long long)(emu->residency_ns[0] - last_emu->residency_ns[0]) / 1000,
+      (unsigned long long)(emu->residency_ns[1] - last_emu->residency_ns[1]) / 1000,
+      (unsigned long long)(emu->residency_ns[2] - last_emu->residency_ns[2]) / 1000,
+      (unsigned long long)(emu->residency_ns[3] - last_emu->residency_ns[3]) / 1000,
+      (unsigned long)(emu->wakes - last_emu->wakes));
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Prints the error counters of a bus.
+ *
+ * @return
+ *   Whether the bus saw a failed transfer or error
+ ******************************************************************************/
+static bool bench_print_bus(const char *name, I2C_TypeDef *i2cx) {
+  I2C_ERROR_STRUCT errors;
+  i2c_get_errors(i2cx, &errors);
+  printf("%s: nacks %lu  timeouts %lu  bus errors %lu  resets %lu  failed resets %lu  failures %lu\n", name,
+      (unsigned long)errors.nacks, (unsigned long)errors.timeouts, (unsigned long)errors.bus_errors,
+      (unsigned long)errors.resets, (unsigned long)errors.failed_resets, (unsigned long)errors.failures);
+  return errors.timeouts || errors.bus_errors || errors.failed_resets || errors.failures;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Decodes the newest logged block the way a host reading the log would.
+ ******************************************************************************/
+static void bench_print_log(void) {
+  uint32_t count = flash_log_count();
+  printf("flash log: %lu blocks\n", (unsigned long)count);
+
+  SAMPLE_BLOCK block;
+  if (count == 0 || !flash_log_read(count - 1, &block)) {
+      return;
+  }
+  SAMPLE_RECORD records[SAMPLE_DECODE_BLOCK_RECORDS];
+  uint32_t num_records = sample_block_decode(&block, records, SAMPLE_DECODE_BLOCK_RECORDS);
+  for (uint32_t i = 0; i < num_records; i++) {
+      int32_t centi;
+      sample_decode_convert(&records[i].code, &centi, 1, &scales[records[i].channel]);
+      printf("  t %6lu  ch %lu  code 0x%04x  %5ld.%02ld\n", (unsigned long)records[i].time,
+          (unsigned long)records[i].channel, records[i].code, (long)(centi / 100), (long)labs(centi % 100));
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Runs the firmware's main loop until the sample cycles are measured.
+ *
+ * @details
+ *   The first argument overrides the number of cycles. Exits non zero if an
+ *   I2C transfer failed or a bus saw an error.
+ ******************************************************************************/
+int main(int argc, char **argv) {
+  uint32_t cycles = argc > 1 ? strtoul(argv[1], NULL, 0) : BENCH_DEFAULT_CYCLES;
+
+  for (uint32_t i = 0; i < sizeof(shtc3_script) / sizeof(shtc3_script[0]); i++) {
+      shtc3_script[i].temp = si7021_script[i].temp + BENCH_SHTC3_OFFSET;
+      shtc3_script[i].humidity = si7021_script[i].humidity - BENCH_SHTC3_OFFSET;
+  }
+
+  fake_hw_open();
+  si7021_model_open(&si7021_model, si7021_script, sizeof(si7021_script) / sizeof(si7021_script[0]));
+  shtc3_model_open(&shtc3_model, shtc3_script, sizeof(shtc3_script) / sizeof(shtc3_script[0]));
+  app_peripheral_setup();
+
+  BENCH_STRUCT bench = {0};
+  FAKE_EMU_STRUCT emu, last_emu;
+  fake_emu_get(&last_emu);
+  uint32_t reported = 0;
+  while (bench.cycles < cycles) {
+      CORE_DECLARE_IRQ_STATE;
+      CORE_ENTER_CRITICAL();
+      if (!get_scheduled_events()) enter_sleep();
+      CORE_EXIT_CRITICAL();
+
+      scheduler_dispatch();
+
+      bench_get(&bench);
+      if (bench.cycles != reported) {
+          reported = bench.cycles;
+          fake_emu_get(&emu);
+          bench_print_cycle(reported, &bench.last, &emu, &last_emu);
+          last_emu = emu;
+      }
+  }
+
+  printf("worst: isr %lu  awake %lu us  bus0 %lu us  bus1 %lu us\n",
+      (unsigned long)bench.worst.isr_count, (unsigned long)bench.worst.awake_us,
+      (unsigned long)bench.worst.bus_busy_us[0], (unsigned long)bench.worst.bus_busy_us[1]);
+  bool failed = bench_print_bus("i2c0", I2C0);
+  failed |= bench_print_bus("i2c1", I2C1);
+  printf("conversions: si7021 %lu  shtc3 %lu\n", (unsigned long)si7021_model.conversions,
+      (unsigned long)shtc3_model.conversions);
+  printf("telemetry: %lu bytes sent, %lu frames dropped\n", (unsigned long)fake_leuart_bytes(),
+      (unsigned long)telemetry_dropped());
+  printf("alarms: humidity high %d  condensation %d  temp high %d  temp low %d\n",
+      alarm_active(ALARM_HUMIDITY_HIGH), alarm_active(ALARM_CONDENSATION),
+      alarm_active(ALARM_TEMP_HIGH), alarm_active(ALARM_TEMP_LOW));
+  bench_print_log();
+  return failed ? 1 : 0;
+}
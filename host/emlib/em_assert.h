@@ -0,0 +1,18 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_ASSERT_HG
+#define EM_ASSERT_HG
+
+/* The developer's include statements */
+#include "fake_hw.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Asserts often read back a flag the code just cleared, so the fakes apply
+// the register writes made so far before the expression is checked.
+#define EFM_ASSERT(expr) \
+  (fake_hw_sync(), (expr) ? (void)0 : fake_hw_assert_failed(__FILE__, __LINE__, #expr))
+
+#endif
@@ -0,0 +1,52 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_CMU_HG
+#define EM_CMU_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  cmuClock_HF,
+  cmuClock_HFPER,
+  cmuClock_CORELE,
+  cmuClock_LFA,
+  cmuClock_LFB,
+  cmuClock_GPIO,
+  cmuClock_I2C0,
+  cmuClock_I2C1,
+  cmuClock_LETIMER0,
+  cmuClock_LEUART0,
+  cmuClock_LDMA,
+  cmuClock_WTIMER0,
+  cmuClock_WTIMER1,
+} CMU_Clock_TypeDef;
+
+typedef enum {
+  cmuOsc_LFXO,
+  cmuOsc_LFRCO,
+  cmuOsc_HFXO,
+  cmuOsc_HFRCO,
+  cmuOsc_ULFRCO,
+} CMU_Osc_TypeDef;
+
+typedef enum {
+  cmuSelect_ULFRCO,
+  cmuSelect_LFRCO,
+  cmuSelect_LFXO,
+  cmuSelect_HFRCO,
+} CMU_Select_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable);
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref);
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait);
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock);
+
+#endif
@@ -0,0 +1,25 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_CORE_HG
+#define EM_CORE_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+/* The developer's include statements */
+#include "fake_hw.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Interrupts pending while masked are taken when the mask is lifted
+#define CORE_DECLARE_IRQ_STATE      uint32_t irqState
+#define CORE_ENTER_CRITICAL()       (irqState = fake_core_enter())
+#define CORE_EXIT_CRITICAL()        fake_core_exit(irqState)
+#define CORE_ENTER_ATOMIC()         CORE_ENTER_CRITICAL()
+#define CORE_EXIT_ATOMIC()          CORE_EXIT_CRITICAL()
+#define CORE_CRITICAL_SECTION(code) { CORE_DECLARE_IRQ_STATE; CORE_ENTER_CRITICAL(); { code } CORE_EXIT_CRITICAL(); }
+#define CORE_ATOMIC_SECTION(code)   CORE_CRITICAL_SECTION(code)
+
+#endif
@@ -0,0 +1,201 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_DEVICE_HG
+#define EM_DEVICE_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// Host stand-in for the EFM32PG12 device header. Only the registers and bits
+// the firmware touches exist. The peripherals are plain structs that
+// fake_hw.c reads back and updates, see fake_hw.h.
+
+#define __CORTEX_M 4U
+#define SL_RAMFUNC_DECLARATOR
+
+// Flash is a host array, erased at fake_hw_open()
+#define FLASH_BASE        ((uintptr_t)fake_flash)
+#define FLASH_SIZE        (1024u * 1024u)
+#define FLASH_PAGE_SIZE   2048u
+#define SRAM_BASE         0x20000000u
+
+// I2C
+#define I2C_CTRL_EN         0x1u
+#define I2C_CTRL_AUTOACK    0x4u
+#define I2C_CTRL_AUTOSE     0x8u
+#define I2C_CTRL_AUTOSN     0x10u
+
+#define I2C_CMD_START       0x1u
+#define I2C_CMD_STOP        0x2u
+#define I2C_CMD_ACK         0x4u
+#define I2C_CMD_NACK        0x8u
+#define I2C_CMD_CONT        0x10u
+#define I2C_CMD_ABORT       0x20u
+#define I2C_CMD_CLEARTX     0x40u
+#define I2C_CMD_CLEARPC     0x80u
+
+#define I2C_STATE_BUSY              0x1u
+#define I2C_STATE_MASTER            0x2u
+#define _I2C_STATE_STATE_MASK       0xE0u
+#define I2C_STATE_STATE_IDLE        0x0u
+#define I2C_STATE_STATE_ADDR        0x60u
+#define I2C_STATE_STATE_DATA        0xA0u
+
+#define I2C_IF_START        0x1u
+#define I2C_IF_RXDATAV      0x20u
+#define I2C_IF_ACK          0x40u
+#define I2C_IF_NACK         0x80u
+#define I2C_IF_MSTOP        0x100u
+#define I2C_IF_ARBLOST      0x200u
+#define I2C_IF_BUSERR       0x400u
+#define I2C_IF_CLTO         0x8000u
+#define I2C_IEN_RXDATAV     I2C_IF_RXDATAV
+#define I2C_IEN_ACK         I2C_IF_ACK
+#define I2C_IEN_NACK        I2C_IF_NACK
+#define I2C_IEN_MSTOP       I2C_IF_MSTOP
+#define I2C_IEN_ARBLOST     I2C_IF_ARBLOST
+#define I2C_IEN_BUSERR      I2C_IF_BUSERR
+
+#define I2C_ROUTEPEN_SDAPEN 0x1u
+#define I2C_ROUTEPEN_SCLPEN 0x2u
+#define I2C_ROUTELOC0_SDALOC_LOC6   6u
+#define I2C_ROUTELOC0_SDALOC_LOC15  15u
+#define I2C_ROUTELOC0_SDALOC_LOC19  19u
+#define I2C_ROUTELOC0_SCLLOC_LOC6   (6u << 8)
+#define I2C_ROUTELOC0_SCLLOC_LOC15  (15u << 8)
+#define I2C_ROUTELOC0_SCLLOC_LOC19  (19u << 8)
+
+// LETIMER
+#define LETIMER_CMD_START       0x1u
+#define LETIMER_CMD_STOP        0x2u
+#define LETIMER_CMD_CLEAR       0x4u
+#define LETIMER_STATUS_RUNNING  0x1u
+#define LETIMER_IF_COMP0        0x1u
+#define LETIMER_IF_COMP1        0x2u
+#define LETIMER_IF_UF           0x4u
+#define LETIMER_IFC_COMP0       LETIMER_IF_COMP0
+#define LETIMER_IFC_COMP1       LETIMER_IF_COMP1
+#define LETIMER_IFC_UF          LETIMER_IF_UF
+#define LETIMER_IFS_COMP1       LETIMER_IF_COMP1
+#define LETIMER_IEN_COMP0       LETIMER_IF_COMP0
+#define LETIMER_IEN_COMP1       LETIMER_IF_COMP1
+#define LETIMER_IEN_UF          LETIMER_IF_UF
+
+// LEUART
+#define LEUART_CTRL_TXDMAWU     0x2000u
+#define LEUART_STATUS_TXC       0x20u
+#define LEUART_IF_TXC           0x1u
+#define LEUART_IFS_TXC          LEUART_IF_TXC
+#define LEUART_IEN_TXC          LEUART_IF_TXC
+#define LEUART_ROUTEPEN_TXPEN   0x2u
+#define LEUART_ROUTELOC0_RXLOC_LOC18 18u
+#define LEUART_ROUTELOC0_TXLOC_LOC18 (18u << 8)
+
+// Core debug
+#define DWT_CTRL_CYCCNTENA_Msk      0x1u
+#define CoreDebug_DEMCR_TRCENA_Msk  (1u << 24)
+#define ITM_TCR_ITMENA_Msk          0x1u
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  I2C0_IRQn,
+  I2C1_IRQn,
+  LETIMER0_IRQn,
+  LDMA_IRQn,
+  LEUART0_IRQn,
+  GPIO_EVEN_IRQn,
+  GPIO_ODD_IRQn,
+  FAKE_IRQ_COUNT // Not a device interrupt
+} IRQn_Type;
+
+typedef struct {
+  volatile uint32_t CTRL, CMD, STATE, STATUS, CLKDIV, SADDR, SADDRMASK;
+  volatile uint32_t RXDATA, RXDOUBLE, RXDATAP, RXDOUBLEP, TXDATA, TXDOUBLE;
+  volatile uint32_t IF, IFS, IFC, IEN, ROUTEPEN, ROUTELOC0;
+} I2C_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL, CMD, STATUS, CNT, COMP0, COMP1, REP0, REP1;
+  volatile uint32_t IF, IFS, IFC, IEN, SYNCBUSY, ROUTEPEN, ROUTELOC0;
+} LETIMER_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL, CMD, STATUS, CLKDIV, TXDATA;
+  volatile uint32_t IF, IFS, IFC, IEN, SYNCBUSY, ROUTEPEN, ROUTELOC0;
+} LEUART_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL, MODEL, MODEH, DOUT, DOUTTGL, DIN;
+} GPIO_P_TypeDef;
+
+typedef struct {
+  GPIO_P_TypeDef P[12];
+  volatile uint32_t IF, IFS, IFC, IEN;
+} GPIO_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL, CMD, STATUS, CNT, TOP;
+} TIMER_TypeDef;
+
+typedef struct {
+  volatile uint32_t CTRL, CYCCNT;
+} DWT_Type;
+
+typedef struct {
+  volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+typedef struct {
+  union {
+    volatile uint8_t u8;
+    volatile uint32_t u32;
+  } PORT[32];
+  volatile uint32_t TER, TCR;
+} ITM_Type;
+
+extern I2C_TypeDef fake_i2c0, fake_i2c1;
+extern LETIMER_TypeDef fake_letimer0;
+extern LEUART_TypeDef fake_leuart0;
+extern GPIO_TypeDef fake_gpio;
+extern TIMER_TypeDef fake_wtimer0, fake_wtimer1;
+extern DWT_Type fake_dwt;
+extern CoreDebug_Type fake_core_debug;
+extern ITM_Type fake_itm;
+extern uint8_t fake_flash[];
+
+#define I2C0        (&fake_i2c0)
+#define I2C1        (&fake_i2c1)
+#define LETIMER0    (&fake_letimer0)
+#define LEUART0     (&fake_leuart0)
+#define GPIO        (&fake_gpio)
+#define WTIMER0     (&fake_wtimer0)
+#define WTIMER1     (&fake_wtimer1)
+#define DWT         (&fake_dwt)
+#define CoreDebug   (&fake_core_debug)
+#define ITM         (&fake_itm)
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void NVIC_EnableIRQ(IRQn_Type irq);
+void NVIC_DisableIRQ(IRQn_Type irq);
+void NVIC_ClearPendingIRQ(IRQn_Type irq);
+void NVIC_SetPendingIRQ(IRQn_Type irq);
+
+// The core is single threaded, the exclusive access pair always succeeds
+static inline uint32_t __LDREXW(volatile uint32_t *addr) { return *addr; }
+static inline uint32_t __STREXW(uint32_t value, volatile uint32_t *addr) { *addr = value; return 0; }
+static inline void __CLREX(void) { }
+static inline void __DMB(void) { }
+static inline void __NOP(void) { }
+static inline uint8_t __CLZ(uint32_t value) { return value ? (uint8_t)__builtin_clz(value) : 32; }
+
+#endif
@@ -0,0 +1,18 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_EMU_HG
+#define EM_EMU_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+// Sleeping runs the simulated hardware until an interrupt is pending
+void EMU_EnterEM1(void);
+void EMU_EnterEM2(bool restore);
+void EMU_EnterEM3(bool restore);
+
+#endif
@@ -0,0 +1,45 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_GPIO_HG
+#define EM_GPIO_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  gpioPortA,
+  gpioPortB,
+  gpioPortC,
+  gpioPortD,
+  gpioPortE,
+  gpioPortF,
+} GPIO_Port_TypeDef;
+
+typedef enum {
+  gpioModeDisabled,
+  gpioModeInput,
+  gpioModePushPull,
+  gpioModeWiredAnd,
+  gpioModeWiredAndPullUp,
+} GPIO_Mode_TypeDef;
+
+typedef enum {
+  gpioDriveStrengthStrongAlternateStrong,
+  gpioDriveStrengthWeakAlternateWeak,
+} GPIO_DriveStrength_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength);
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out);
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo, bool risingEdge, bool fallingEdge, bool enable);
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin);
+void GPIO_DbgSWOEnable(bool enable);
+
+#endif
@@ -0,0 +1,47 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_I2C_HG
+#define EM_I2C_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+/* The developer's include statements */
+#include "fake_hw.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define I2C_FREQ_STANDARD_MAX 92000
+#define I2C_FREQ_FAST_MAX     392157
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  i2cClockHLRStandard,
+  i2cClockHLRAsymetric,
+  i2cClockHLRFast,
+} I2C_ClockHLR_TypeDef;
+
+typedef struct {
+  bool enable;
+  bool master;
+  uint32_t refFreq;
+  uint32_t freq;
+  I2C_ClockHLR_TypeDef clhr;
+} I2C_Init_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init);
+
+// A poll of IF lets the fake bus move on, see fake_hw_sync()
+static inline uint32_t I2C_IntGet(I2C_TypeDef *i2c) {
+  fake_hw_sync();
+  return i2c->IF;
+}
+
+#endif
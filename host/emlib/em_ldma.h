@@ -0,0 +1,78 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_LDMA_HG
+#define EM_LDMA_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LDMA_IF_ERROR (1u << 31)
+
+#define LDMA_INIT_DEFAULT { 0 }
+#define LDMA_TRANSFER_CFG_PERIPHERAL(signal) { (signal) }
+
+// Only the fields the fake moves data by. A link is relative, in descriptors.
+#define LDMA_DESCRIPTOR_SINGLE_P2M_BYTE(src, dest, count) \
+  { .xfer = { ldmaFakeByte, (volatile void *)(src), (volatile void *)(dest), (count), false, 0, true, false, true } }
+#define LDMA_DESCRIPTOR_SINGLE_M2P_BYTE(src, dest, count) \
+  { .xfer = { ldmaFakeByte, (volatile void *)(src), (volatile void *)(dest), (count), false, 0, true, true, false } }
+#define LDMA_DESCRIPTOR_LINKREL_P2M_BYTE(src, dest, count, linkjmp) \
+  { .xfer = { ldmaFakeByte, (volatile void *)(src), (volatile void *)(dest), (count), true, (linkjmp), false, false, true } }
+#define LDMA_DESCRIPTOR_SINGLE_M2M_WORD(src, dest, count) \
+  { .xfer = { ldmaFakeWord, (volatile void *)(src), (volatile void *)(dest), (count), false, 0, true, true, true } }
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  ldmaPeripheralSignal_NONE,
+  ldmaPeripheralSignal_I2C0_RXDATAV,
+  ldmaPeripheralSignal_I2C0_TXBL,
+  ldmaPeripheralSignal_I2C1_RXDATAV,
+  ldmaPeripheralSignal_I2C1_TXBL,
+  ldmaPeripheralSignal_LEUART0_TXBL,
+} LDMA_PeripheralSignal_t;
+
+typedef enum {
+  ldmaFakeByte,
+  ldmaFakeWord,
+} LDMA_FakeSize_t;
+
+typedef struct {
+  uint32_t unused;
+} LDMA_Init_t;
+
+typedef struct {
+  LDMA_PeripheralSignal_t ldmaReqSel;
+} LDMA_TransferCfg_t;
+
+typedef union {
+  struct {
+    LDMA_FakeSize_t size;
+    volatile void *srcAddr;
+    volatile void *dstAddr;
+    uint32_t xferCnt;
+    bool link;
+    int32_t linkAddr;
+    bool doneIfs;
+    bool srcInc;
+    bool dstInc;
+  } xfer;
+} LDMA_Descriptor_t;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void LDMA_Init(const LDMA_Init_t *init);
+void LDMA_StartTransfer(int ch, const LDMA_TransferCfg_t *transfer, const LDMA_Descriptor_t *descriptor);
+void LDMA_StopTransfer(int ch);
+bool LDMA_TransferDone(int ch);
+uint32_t LDMA_IntGet(void);
+uint32_t LDMA_IntGetEnabled(void);
+void LDMA_IntClear(uint32_t flags);
+
+#endif
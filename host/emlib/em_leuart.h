@@ -0,0 +1,43 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_LEUART_HG
+#define EM_LEUART_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define LEUART_INIT_DEFAULT { leuartEnable, 0, 9600, leuartDatabits8, leuartNoParity, leuartStopbits1 }
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  leuartDisable,
+  leuartEnableRx,
+  leuartEnableTx,
+  leuartEnable,
+} LEUART_Enable_TypeDef;
+
+typedef enum { leuartDatabits8 } LEUART_Databits_TypeDef;
+typedef enum { leuartNoParity } LEUART_Parity_TypeDef;
+typedef enum { leuartStopbits1 } LEUART_Stopbits_TypeDef;
+
+typedef struct {
+  LEUART_Enable_TypeDef enable;
+  uint32_t refFreq;
+  uint32_t baudrate;
+  LEUART_Databits_TypeDef databits;
+  LEUART_Parity_TypeDef parity;
+  LEUART_Stopbits_TypeDef stopbits;
+} LEUART_Init_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void LEUART_Init(LEUART_TypeDef *leuart, const LEUART_Init_TypeDef *init);
+
+#endif
@@ -0,0 +1,27 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_MSC_HG
+#define EM_MSC_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  mscReturnOk = 0,
+  mscReturnInvalidAddr = -1,
+} MSC_Status_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+// Writes can only clear bits, as on the real flash
+void MSC_Init(void);
+void MSC_Deinit(void);
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress);
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes);
+
+#endif
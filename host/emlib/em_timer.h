@@ -0,0 +1,43 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef EM_TIMER_HG
+#define EM_TIMER_HG
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define TIMER_INIT_DEFAULT { true, false, false, timerModeUp, timerPrescale1 }
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+typedef enum {
+  timerModeUp,
+  timerModeDown,
+} TIMER_Mode_TypeDef;
+
+typedef enum {
+  timerPrescale1 = 0,
+  timerPrescale16 = 4,
+  timerPrescale1024 = 10,
+} TIMER_Prescale_TypeDef;
+
+typedef struct {
+  bool enable;
+  bool debugRun;
+  bool oneShot;
+  TIMER_Mode_TypeDef mode;
+  TIMER_Prescale_TypeDef prescale;
+} TIMER_Init_TypeDef;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+// Only free running up counts, which count simulated time in EM0 and EM1
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init);
+
+#endif
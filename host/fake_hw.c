@@ -0,0 +1,904 @@
+/*****************************************************
+ * @file fake_hw.c
+ * @author Branson Camp
+ * @date 12/16/2022
+ * @brief Register level stand-ins for the peripherals
+ * the firmware uses, run on simulated time.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+/* System include statements */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+#include "em_cmu.h"
+#include "em_emu.h"
+#include "em_gpio.h"
+#include "em_i2c.h"
+#include "em_ldma.h"
+#include "em_letimer.h"
+#include "em_leuart.h"
+#include "em_msc.h"
+#include "em_timer.h"
+
+/* The developer's include statements */
+#include "fake_hw.h"
+#include "brd_config.h"
+#include "gpio.h"
+#include "i2c.h"
+#include "ldma.h"
+#include "letimer.h"
+#include "leuart.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define NS_PER_S            1000000000ull
+#define NO_EVENT            UINT64_MAX
+#define REG_EMPTY           0x100u  // TXDATA holds no byte, outside any byte value
+#define DELIVER_LIMIT       100000  // Interrupts taken in a row before a stuck flag is assumed
+
+#define I2C_ADDR_BITS       10  // Start, address, R/W and ACK
+#define I2C_BYTE_BITS       9   // Data and ACK
+#define LEUART_FRAME_BITS   10  // Start, 8 data, stop
+#define HFPER_HZ            32000000u // MCU_HFXO_FREQ, the HFPER clock undivided
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+typedef enum {
+  BUS_IDLE,
+  BUS_ADDR, // Address being sent
+  BUS_TX, // Data byte being sent
+  BUS_TX_WAIT, // Slave ACKed, waiting for TXDATA
+  BUS_NACKED, // Slave NACKed, waiting for a start or stop
+  BUS_RX, // Data byte being received
+  BUS_RX_WAIT, // Byte received, waiting for ACK or NACK
+  BUS_RX_HOLD, // Byte ACKed, waiting for RXDATA to be read
+  BUS_RX_NACKED, // Last byte NACKed, waiting for a stop
+} FAKE_BUS_STATE;
+
+typedef struct {
+  I2C_TypeDef *regs;
+  LDMA_PeripheralSignal_t rx_signal;
+  FAKE_BUS_STATE state;
+  bool start_pending; // START given, sent with the next TXDATA
+  uint32_t tx_byte; // Byte taken from TXDATA, or REG_EMPTY
+  uint32_t shift; // Byte on the wire
+  uint64_t op_end; // End of the address or byte on the wire, or NO_EVENT
+  uint64_t bit_ns;
+  const FAKE_I2C_DEVICE_STRUCT *devices[FAKE_I2C_MAX_DEVICES];
+  const FAKE_I2C_DEVICE_STRUCT *slave; // Addressed slave
+} FAKE_BUS_STRUCT;
+
+typedef struct {
+  bool active;
+  LDMA_PeripheralSignal_t signal;
+  const LDMA_Descriptor_t *desc;
+  volatile uint8_t *src;
+  volatile uint8_t *dst;
+  uint32_t remaining;
+} FAKE_LDMA_CHANNEL_STRUCT;
+
+typedef struct {
+  TIMER_TypeDef *regs;
+  bool running;
+  uint32_t prescale; // log2 of the HFPER divide
+  uint64_t base_ns; // fake_hf_ns() when the count started from 0
+} FAKE_TIMER_STRUCT;
+
+I2C_TypeDef fake_i2c0, fake_i2c1;
+LETIMER_TypeDef fake_letimer0;
+LEUART_TypeDef fake_leuart0;
+GPIO_TypeDef fake_gpio;
+TIMER_TypeDef fake_wtimer0, fake_wtimer1;
+DWT_Type fake_dwt;
+CoreDebug_Type fake_core_debug;
+ITM_Type fake_itm;
+uint8_t fake_flash[FLASH_SIZE] __attribute__((aligned(FLASH_PAGE_SIZE)));
+
+static uint64_t now_ns; // Simulated time
+static bool primask; // Interrupts masked
+static bool in_isr;
+static bool nvic_enabled[FAKE_IRQ_COUNT];
+static bool nvic_pending[FAKE_IRQ_COUNT];
+
+static FAKE_BUS_STRUCT buses[2];
+
+static uint64_t letimer_next_tick; // NO_EVENT while stopped
+
+static uint64_t leuart_bit_ns;
+static uint64_t leuart_shift_end; // NO_EVENT while the shifter is empty
+static bool leuart_buffer_full;
+static uint32_t leuart_sent;
+
+static FAKE_LDMA_CHANNEL_STRUCT ldma_channels[LDMA_NUM_CHANNELS];
+static uint32_t ldma_if;
+
+static uint32_t gpio_dout[12]; // DOUT as last seen
+static uint64_t gpio_changed[12][16]; // Time each pin last changed
+
+static FAKE_TIMER_STRUCT timers[2];
+
+static FAKE_EMU_STRUCT emu;
+static uint64_t awake_since; // Simulated time the last sleep ended
+static uint64_t asleep_since; // Simulated time the current sleep started
+static int sleep_em; // Energy mode slept in, 0 while awake
+static uint64_t cpu_last_ns; // Host CPU time at the last CYCCNT update
+
+static void (*const irq_handlers[FAKE_IRQ_COUNT])(void) = {
+  I2C0_IRQHandler,
+  I2C1_IRQHandler,
+  LETIMER0_IRQHandler,
+  LDMA_IRQHandler,
+  LEUART0_IRQHandler,
+  GPIO_EVEN_IRQHandler,
+  GPIO_ODD_IRQHandler,
+};
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static void fake_fatal(const char *what) __attribute__((noreturn));
+static void fake_fatal(const char *what) {
+  fprintf(stderr, "fake_hw: %s at %llu ns\n", what, (unsigned long long)now_ns);
+  exit(2);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Host CPU time of this thread, the base of the fake CYCCNT.
+ ******************************************************************************/
+static uint64_t fake_cpu_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return (uint64_t)ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Adds the host CPU time since the last call to CYCCNT.
+ *
+ * @details
+ *   CYCCNT counts host nanoseconds while the firmware is awake and stops
+ *   while it sleeps, so it compares runs on one host only.
+ ******************************************************************************/
+static void fake_cyccnt_update(bool counting) {
+  uint64_t cpu = fake_cpu_ns();
+  if (counting && (fake_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+      fake_dwt.CYCCNT += (uint32_t)(cpu - cpu_last_ns);
+  }
+  cpu_last_ns = cpu;
+}
+
+static void fake_ldma_load(uint32_t ch, const LDMA_Descriptor_t *desc);
+
+/***************************************************************************//**
+ * @brief
+ *   Ends the descriptor of a channel and follows its link.
+ ******************************************************************************/
+static void fake_ldma_next(uint32_t ch) {
+  FAKE_LDMA_CHANNEL_STRUCT *channel = &ldma_channels[ch];
+  const LDMA_Descriptor_t *desc = channel->desc;
+  if (desc->xfer.doneIfs) {
+      ldma_if |= 1u << ch;
+  }
+  if (desc->xfer.link) {
+      fake_ldma_load(ch, desc + desc->xfer.linkAddr);
+  } else {
+      channel->active = false;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Loads a descriptor into a channel.
+ ******************************************************************************/
+static void fake_ldma_load(uint32_t ch, const LDMA_Descriptor_t *desc) {
+  FAKE_LDMA_CHANNEL_STRUCT *channel = &ldma_channels[ch];
+  channel->desc = desc;
+  channel->src = desc->xfer.srcAddr;
+  channel->dst = desc->xfer.dstAddr;
+  channel->remaining = desc->xfer.xferCnt;
+  channel->active = true;
+
+  if (desc->xfer.srcInc && desc->xfer.dstInc) {
+      // Memory to memory needs no request
+      size_t unit = desc->xfer.size == ldmaFakeWord ? 4 : 1;
+      memcpy((void *)channel->dst, (const void *)channel->src, unit * channel->remaining);
+      fake_ldma_next(ch);
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Serves a peripheral request on the channel that waits for it.
+ *
+ * @details
+ *   Moves one byte. A finished descriptor follows its link, and a memory to
+ *   memory descriptor is run straight away, as the LDMA would.
+ *
+ * @return
+ *   Whether a byte was moved.
+ ******************************************************************************/
+static bool fake_ldma_request(LDMA_PeripheralSignal_t signal) {
+  for (uint32_t ch = 0; ch < LDMA_NUM_CHANNELS; ch++) {
+      FAKE_LDMA_CHANNEL_STRUCT *channel = &ldma_channels[ch];
+      if (!channel->active || channel->signal != signal) {
+          continue;
+      }
+      const LDMA_Descriptor_t *desc = channel->desc;
+      uint8_t byte = desc->xfer.srcInc ? *channel->src++ : *(volatile uint32_t *)channel->src & 0xFF;
+      if (desc->xfer.dstInc) {
+          *channel->dst++ = byte;
+      } else {
+          *(volatile uint32_t *)channel->dst = byte;
+      }
+      if (--channel->remaining == 0) {
+          fake_ldma_next(ch);
+      }
+      return true;
+  }
+  return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Puts an address or data byte on the wire.
+ ******************************************************************************/
+static void fake_bus_begin(FAKE_BUS_STRUCT *bus, FAKE_BUS_STATE state, uint32_t bits) {
+  bus->state = state;
+  bus->op_end = now_ns + bits * bus->bit_ns;
+}
+
+static void fake_bus_release(FAKE_BUS_STRUCT *bus) {
+  if (bus->slave && bus->slave->stop) {
+      bus->slave->stop(bus->slave->ctx);
+  }
+  bus->slave = NULL;
+  bus->state = BUS_IDLE;
+  bus->start_pending = false;
+  bus->op_end = NO_EVENT;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Applies the register writes made to an I2C since the last sync.
+ *
+ * @details
+ *   A write to CMD only keeps the last command, so a START directly followed
+ *   by a STOP is seen as the STOP. STOP ends the transfer at once and always
+ *   sets MSTOP, which is what the bus reset relies on. Reading RXDATA cannot
+ *   be seen, clearing the RXDATAV flag counts as the read.
+ ******************************************************************************/
+static void fake_bus_sync(FAKE_BUS_STRUCT *bus) {
+  I2C_TypeDef *regs = bus->regs;
+  regs->IF = (regs->IF | regs->IFS) & ~regs->IFC;
+  regs->IFS = 0;
+  regs->IFC = 0;
+
+  uint32_t cmd = regs->CMD;
+  regs->CMD = 0;
+  if (cmd & I2C_CMD_ABORT) {
+      fake_bus_release(bus);
+      bus->tx_byte = REG_EMPTY;
+  }
+  if (cmd & I2C_CMD_CLEARTX) {
+      bus->tx_byte = REG_EMPTY;
+  }
+  if (cmd & I2C_CMD_START) {
+      bus->start_pending = true;
+  }
+  if (cmd & I2C_CMD_STOP) {
+      fake_bus_release(bus);
+      regs->IF |= I2C_IF_MSTOP;
+  }
+  if ((cmd & I2C_CMD_ACK) && bus->state == BUS_RX_WAIT) {
+      fake_bus_begin(bus, BUS_RX, I2C_BYTE_BITS);
+  }
+  if ((cmd & I2C_CMD_NACK) && bus->state == BUS_RX_WAIT) {
+      bus->state = BUS_RX_NACKED;
+  }
+  if (bus->state == BUS_RX_HOLD && !(regs->IF & I2C_IF_RXDATAV)) {
+      fake_bus_begin(bus, BUS_RX, I2C_BYTE_BITS);
+  }
+
+  if (regs->TXDATA != REG_EMPTY) {
+      bus->tx_byte = regs->TXDATA & 0xFF;
+      regs->TXDATA = REG_EMPTY;
+  }
+
+  if (bus->op_end != NO_EVENT || bus->tx_byte == REG_EMPTY) {
+      // The wire is busy or there is nothing to send
+  } else if (bus->start_pending && bus->state != BUS_RX && bus->state != BUS_RX_HOLD) {
+      bus->start_pending = false;
+      if (bus->slave && bus->slave->stop) {
+          bus->slave->stop(bus->slave->ctx); // A repeated start ends the write
+      }
+      bus->slave = NULL;
+      bus->shift = bus->tx_byte;
+      bus->tx_byte = REG_EMPTY;
+      fake_bus_begin(bus, BUS_ADDR, I2C_ADDR_BITS);
+  } else if (bus->state == BUS_TX_WAIT) {
+      bus->shift = bus->tx_byte;
+      bus->tx_byte = REG_EMPTY;
+      fake_bus_begin(bus, BUS_TX, I2C_BYTE_BITS);
+  }
+
+  regs->STATE = bus->state == BUS_IDLE ? I2C_STATE_STATE_IDLE : (I2C_STATE_BUSY | I2C_STATE_MASTER | I2C_STATE_STATE_DATA);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Finishes the address or byte on the wire.
+ ******************************************************************************/
+static void fake_bus_complete(FAKE_BUS_STRUCT *bus) {
+  I2C_TypeDef *regs = bus->regs;
+  bus->op_end = NO_EVENT;
+
+  switch (bus->state) {
+    case BUS_ADDR: {
+      bool read = bus->shift & 1;
+      bool ack = false;
+      for (int i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+          const FAKE_I2C_DEVICE_STRUCT *device = bus->devices[i];
+          if (device && device->address == (bus->shift >> 1)) {
+              ack = device->start(device->ctx, read);
+              bus->slave = ack ? device : NULL;
+          }
+      }
+      regs->IF |= ack ? I2C_IF_ACK : I2C_IF_NACK;
+      if (!ack) {
+          bus->state = BUS_NACKED;
+      } else if (read) {
+          fake_bus_begin(bus, BUS_RX, I2C_BYTE_BITS);
+      } else {
+          bus->state = BUS_TX_WAIT;
+      }
+      break;
+    }
+    case BUS_TX: {
+      bool ack = bus->slave->write(bus->slave->ctx, bus->shift);
+      regs->IF |= ack ? I2C_IF_ACK : I2C_IF_NACK;
+      bus->state = ack ? BUS_TX_WAIT : BUS_NACKED;
+      break;
+    }
+    case BUS_RX: {
+      regs->RXDATA = bus->slave->read(bus->slave->ctx);
+      regs->IF |= I2C_IF_RXDATAV;
+      bool acked = regs->CTRL & I2C_CTRL_AUTOACK; // Decided before the LDMA can turn it off
+      if (fake_ldma_request(bus->rx_signal)) {
+          regs->IF &= ~I2C_IF_RXDATAV;
+      }
+      if (!acked) {
+          bus->state = BUS_RX_WAIT;
+      } else if (!(regs->IF & I2C_IF_RXDATAV)) {
+          fake_bus_begin(bus, BUS_RX, I2C_BYTE_BITS);
+      } else {
+          bus->state = BUS_RX_HOLD;
+      }
+      break;
+    }
+    default:
+      fake_fatal("I2C completion without a transfer");
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Applies the register writes made to LETIMER0.
+ ******************************************************************************/
+static void fake_letimer_sync(void) {
+  LETIMER_TypeDef *regs = &fake_letimer0;
+  regs->IF = (regs->IF | regs->IFS) & ~regs->IFC;
+  regs->IFS = 0;
+  regs->IFC = 0;
+
+  uint32_t cmd = regs->CMD;
+  regs->CMD = 0;
+  if (cmd & LETIMER_CMD_CLEAR) {
+      regs->CNT = 0;
+  }
+  if ((cmd & LETIMER_CMD_START) && !(regs->STATUS & LETIMER_STATUS_RUNNING)) {
+      regs->STATUS |= LETIMER_STATUS_RUNNING;
+      letimer_next_tick = now_ns + NS_PER_S / LETIMER_HZ;
+  }
+  if (cmd & LETIMER_CMD_STOP) {
+      regs->STATUS &= ~LETIMER_STATUS_RUNNING;
+      letimer_next_tick = NO_EVENT;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Counts LETIMER0 down by one tick.
+ *
+ * @details
+ *   CNT reloads from COMP0 on underflow, so a period is COMP0 + 1 ticks.
+ ******************************************************************************/
+static void fake_letimer_tick(void) {
+  LETIMER_TypeDef *regs = &fake_letimer0;
+  letimer_next_tick += NS_PER_S / LETIMER_HZ;
+  if (regs->CNT == 0) {
+      regs->CNT = regs->COMP0;
+      regs->IF |= LETIMER_IF_UF;
+  } else {
+      regs->CNT--;
+  }
+  if (regs->CNT == regs->COMP1) {
+      regs->IF |= LETIMER_IF_COMP1;
+  }
+  if (regs->CNT == regs->COMP0) {
+      regs->IF |= LETIMER_IF_COMP0;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Applies the register writes made to LEUART0 and feeds its shifter.
+ ******************************************************************************/
+static void fake_leuart_sync(void) {
+  LEUART_TypeDef *regs = &fake_leuart0;
+  regs->IF = (regs->IF | regs->IFS) & ~regs->IFC;
+  regs->IFS = 0;
+  regs->IFC = 0;
+
+  while (true) {
+      if (!leuart_buffer_full) {
+          fake_ldma_request(ldmaPeripheralSignal_LEUART0_TXBL); // TXBL asks the LDMA to write TXDATA
+      }
+      if (regs->TXDATA != REG_EMPTY) {
+          regs->TXDATA = REG_EMPTY;
+          leuart_buffer_full = true;
+          regs->STATUS &= ~LEUART_STATUS_TXC;
+      }
+      if (!leuart_buffer_full || leuart_shift_end != NO_EVENT) {
+          break;
+      }
+      leuart_buffer_full = false;
+      leuart_shift_end = now_ns + LEUART_FRAME_BITS * leuart_bit_ns;
+  }
+}
+
+static void fake_leuart_complete(void) {
+  leuart_shift_end = NO_EVENT;
+  leuart_sent++;
+  if (!leuart_buffer_full) {
+      fake_leuart0.STATUS |= LEUART_STATUS_TXC;
+      fake_leuart0.IF |= LEUART_IF_TXC;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Timestamps the GPIO outputs that changed.
+ ******************************************************************************/
+static void fake_gpio_sync(void) {
+  GPIO_TypeDef *regs = &fake_gpio;
+  regs->IF = (regs->IF | regs->IFS) & ~regs->IFC;
+  regs->IFS = 0;
+  regs->IFC = 0;
+
+  for (int port = 0; port < 12; port++) {
+      uint32_t changed = regs->P[port].DOUT ^ gpio_dout[port];
+      for (int pin = 0; pin < 16; pin++) {
+          if (changed & (1u << pin)) {
+              gpio_changed[port][pin] = now_ns;
+          }
+      }
+      gpio_dout[port] = regs->P[port].DOUT;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Simulated time the HF clocks have run, which is the time spent in EM0
+ *   and EM1.
+ ******************************************************************************/
+static uint64_t fake_hf_ns(void) {
+  uint64_t hf_ns = emu.residency_ns[0] + emu.residency_ns[1];
+  if (sleep_em == 0) {
+      hf_ns += now_ns - awake_since;
+  } else if (sleep_em == 1) {
+      hf_ns += now_ns - asleep_since;
+  }
+  return hf_ns;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Brings the count of the running timers up to date.
+ ******************************************************************************/
+static void fake_timer_sync(void) {
+  for (int i = 0; i < 2; i++) {
+      FAKE_TIMER_STRUCT *timer = &timers[i];
+      if (timer->running) {
+          uint64_t khz = (HFPER_HZ >> timer->prescale) / 1000u;
+          timer->regs->CNT = (uint32_t)((fake_hf_ns() - timer->base_ns) * khz / 1000000u);
+      }
+  }
+}
+
+static void fake_sync_registers(void) {
+  fake_bus_sync(&buses[0]);
+  fake_bus_sync(&buses[1]);
+  fake_letimer_sync();
+  fake_leuart_sync();
+  fake_gpio_sync();
+  fake_timer_sync();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Whether an enabled interrupt is pending, masked or not.
+ ******************************************************************************/
+static bool fake_irq_pending(IRQn_Type irq) {
+  uint32_t flags;
+  switch (irq) {
+    case I2C0_IRQn:      flags = fake_i2c0.IF & fake_i2c0.IEN; break;
+    case I2C1_IRQn:      flags = fake_i2c1.IF & fake_i2c1.IEN; break;
+    case LETIMER0_IRQn:  flags = fake_letimer0.IF & fake_letimer0.IEN; break;
+    case LDMA_IRQn:      flags = ldma_if; break;
+    case LEUART0_IRQn:   flags = fake_leuart0.IF & fake_leuart0.IEN; break;
+    case GPIO_EVEN_IRQn: flags = fake_gpio.IF & fake_gpio.IEN & 0x5555; break;
+    case GPIO_ODD_IRQn:  flags = fake_gpio.IF & fake_gpio.IEN & 0xAAAA; break;
+    default:             flags = 0; break;
+  }
+  return nvic_enabled[irq] && (flags || nvic_pending[irq]);
+}
+
+static bool fake_any_pending(void) {
+  for (int irq = 0; irq < FAKE_IRQ_COUNT; irq++) {
+      if (fake_irq_pending(irq)) {
+          return true;
+      }
+  }
+  return false;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Takes the pending interrupts, lowest IRQ number first.
+ *
+ * @details
+ *   Handlers do not nest. A handler that leaves its flag set is taken again,
+ *   so a flag that is never cleared ends the run.
+ ******************************************************************************/
+static void fake_deliver(void) {
+  if (primask || in_isr) {
+      return;
+  }
+  for (int taken = 0; taken < DELIVER_LIMIT; taken++) {
+      fake_sync_registers();
+      int irq = 0;
+      while (irq < FAKE_IRQ_COUNT && !fake_irq_pending(irq)) {
+          irq++;
+      }
+      if (irq == FAKE_IRQ_COUNT) {
+          return;
+      }
+      nvic_pending[irq] = false;
+      in_isr = true;
+      irq_handlers[irq]();
+      in_isr = false;
+  }
+  fake_fatal("interrupt flag never cleared");
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Time of the next peripheral event.
+ ******************************************************************************/
+static uint64_t fake_next_event(void) {
+  uint64_t next = letimer_next_tick;
+  for (int i = 0; i < 2; i++) {
+      if (buses[i].op_end < next) {
+          next = buses[i].op_end;
+      }
+  }
+  if (leuart_shift_end < next) {
+      next = leuart_shift_end;
+  }
+  return next;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Moves simulated time to the next event and runs it.
+ ******************************************************************************/
+static void fake_run_next_event(void) {
+  uint64_t next = fake_next_event();
+  if (next == NO_EVENT) {
+      fake_fatal("nothing left to happen");
+  }
+  now_ns = next;
+  if (letimer_next_tick == now_ns) {
+      fake_letimer_tick();
+  }
+  for (int i = 0; i < 2; i++) {
+      if (buses[i].op_end == now_ns) {
+          fake_bus_complete(&buses[i]);
+      }
+  }
+  if (leuart_shift_end == now_ns) {
+      fake_leuart_complete();
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Sleeps in an energy mode until an interrupt is pending.
+ *
+ * @details
+ *   Traps a sleep that the running peripherals do not allow: an I2C transfer
+ *   needs EM1, and LEUART0 stops in EM3.
+ ******************************************************************************/
+static void fake_sleep(int em) {
+  fake_cyccnt_update(true);
+  emu.residency_ns[0] += now_ns - awake_since;
+  asleep_since = now_ns;
+  sleep_em = em;
+
+  fake_sync_registers();
+  while (!fake_any_pending()) {
+      if (em >= 2 && (buses[0].state != BUS_IDLE || buses[1].state != BUS_IDLE)) {
+          fake_fatal("I2C transfer in EM2 or below");
+      }
+      if (em >= 3 && leuart_shift_end != NO_EVENT) {
+          fake_fatal("LEUART transmission in EM3");
+      }
+      fake_run_next_event();
+      fake_sync_registers();
+  }
+
+  emu.residency_ns[em] += now_ns - asleep_since;
+  emu.wakes++;
+  awake_since = now_ns;
+  sleep_em = 0;
+  fake_cyccnt_update(false);
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Resets the fake peripherals, simulated time and flash.
+ ******************************************************************************/
+void fake_hw_open(void) {
+  memset(&fake_i2c0, 0, sizeof(fake_i2c0));
+  memset(&fake_i2c1, 0, sizeof(fake_i2c1));
+  memset(&fake_letimer0, 0, sizeof(fake_letimer0));
+  memset(&fake_leuart0, 0, sizeof(fake_leuart0));
+  memset(&fake_gpio, 0, sizeof(fake_gpio));
+  memset(fake_flash, 0xFF, sizeof(fake_flash));
+  memset(buses, 0, sizeof(buses));
+  memset(ldma_channels, 0, sizeof(ldma_channels));
+  memset(&emu, 0, sizeof(emu));
+  memset(&fake_wtimer0, 0, sizeof(fake_wtimer0));
+  memset(&fake_wtimer1, 0, sizeof(fake_wtimer1));
+  memset(timers, 0, sizeof(timers));
+  timers[0].regs = &fake_wtimer0;
+  timers[1].regs = &fake_wtimer1;
+
+  for (int i = 0; i < 2; i++) {
+      buses[i].regs = i ? &fake_i2c1 : &fake_i2c0;
+      buses[i].rx_signal = i ? ldmaPeripheralSignal_I2C1_RXDATAV : ldmaPeripheralSignal_I2C0_RXDATAV;
+      buses[i].tx_byte = REG_EMPTY;
+      buses[i].op_end = NO_EVENT;
+      buses[i].bit_ns = NS_PER_S / I2C_FREQ_FAST_MAX;
+      buses[i].regs->TXDATA = REG_EMPTY;
+  }
+  fake_leuart0.TXDATA = REG_EMPTY;
+  fake_leuart0.STATUS = LEUART_STATUS_TXC;
+  leuart_shift_end = NO_EVENT;
+  leuart_bit_ns = NS_PER_S / 9600;
+  letimer_next_tick = NO_EVENT;
+  now_ns = 0;
+  awake_since = 0;
+  sleep_em = 0;
+  primask = false;
+  in_isr = false;
+  cpu_last_ns = fake_cpu_ns();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Applies the register writes made since the last sync.
+ *
+ * @details
+ *   Interrupts raised by them are taken right away unless masked, as they
+ *   would preempt the running code.
+ ******************************************************************************/
+void fake_hw_sync(void) {
+  fake_sync_registers();
+  fake_deliver();
+}
+
+void fake_hw_assert_failed(const char *file, int line, const char *expr) {
+  fprintf(stderr, "%s:%d: EFM_ASSERT(%s) failed at %llu ns\n", file, line, expr, (unsigned long long)now_ns);
+  exit(1);
+}
+
+uint64_t fake_hw_now(void) {
+  return now_ns;
+}
+
+uint32_t fake_core_enter(void) {
+  bool state = primask;
+  primask = true;
+  fake_cyccnt_update(true);
+  fake_sync_registers();
+  return state;
+}
+
+void fake_core_exit(uint32_t state) {
+  primask = state;
+  fake_hw_sync();
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Connects a slave model to a bus.
+ ******************************************************************************/
+void fake_i2c_attach(I2C_TypeDef *i2c, const FAKE_I2C_DEVICE_STRUCT *device) {
+  FAKE_BUS_STRUCT *bus = &buses[i2c == &fake_i2c1];
+  for (int i = 0; i < FAKE_I2C_MAX_DEVICES; i++) {
+      if (!bus->devices[i]) {
+          bus->devices[i] = device;
+          return;
+      }
+  }
+  fake_fatal("too many I2C devices");
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Reads a GPIO output and the time it last changed.
+ ******************************************************************************/
+bool fake_gpio_pin(unsigned int port, unsigned int pin, uint64_t *since) {
+  fake_gpio_sync();
+  if (since) {
+      *since = gpio_changed[port][pin];
+  }
+  return fake_gpio.P[port].DOUT & (1u << pin);
+}
+
+void fake_emu_get(FAKE_EMU_STRUCT *result) {
+  *result = emu;
+  result->residency_ns[0] += now_ns - awake_since;
+}
+
+uint32_t fake_leuart_bytes(void) {
+  return leuart_sent;
+}
+
+//***********************************************************************************
+// emlib stand-ins
+//***********************************************************************************
+void NVIC_EnableIRQ(IRQn_Type irq) { nvic_enabled[irq] = true; }
+void NVIC_DisableIRQ(IRQn_Type irq) { nvic_enabled[irq] = false; }
+void NVIC_ClearPendingIRQ(IRQn_Type irq) { nvic_pending[irq] = false; }
+void NVIC_SetPendingIRQ(IRQn_Type irq) { nvic_pending[irq] = true; fake_hw_sync(); }
+
+void CMU_ClockEnable(CMU_Clock_TypeDef clock, bool enable) { }
+void CMU_ClockSelectSet(CMU_Clock_TypeDef clock, CMU_Select_TypeDef ref) { }
+void CMU_OscillatorEnable(CMU_Osc_TypeDef osc, bool enable, bool wait) { }
+
+uint32_t CMU_ClockFreqGet(CMU_Clock_TypeDef clock) {
+  switch (clock) {
+    case cmuClock_HF:
+    case cmuClock_HFPER:
+    case cmuClock_WTIMER0:
+    case cmuClock_WTIMER1:
+      return HFPER_HZ;
+    default:
+      fake_fatal("clock frequency not modelled");
+  }
+}
+
+void EMU_EnterEM1(void) { fake_sleep(1); }
+void EMU_EnterEM2(bool restore) { fake_sleep(2); }
+void EMU_EnterEM3(bool restore) { fake_sleep(3); }
+
+void GPIO_DriveStrengthSet(GPIO_Port_TypeDef port, GPIO_DriveStrength_TypeDef strength) { }
+void GPIO_ExtIntConfig(GPIO_Port_TypeDef port, unsigned int pin, unsigned int intNo, bool risingEdge, bool fallingEdge, bool enable) {
+  if (enable) {
+      fake_gpio.IEN |= 1u << intNo;
+  }
+}
+void GPIO_DbgSWOEnable(bool enable) { }
+
+void GPIO_PinModeSet(GPIO_Port_TypeDef port, unsigned int pin, GPIO_Mode_TypeDef mode, unsigned int out) {
+  if (out) {
+      fake_gpio.P[port].DOUT |= 1u << pin;
+  } else {
+      fake_gpio.P[port].DOUT &= ~(1u << pin);
+  }
+  fake_gpio_sync();
+}
+
+void GPIO_PinOutSet(GPIO_Port_TypeDef port, unsigned int pin) {
+  fake_gpio.P[port].DOUT |= 1u << pin;
+  fake_gpio_sync();
+}
+
+void GPIO_PinOutClear(GPIO_Port_TypeDef port, unsigned int pin) {
+  fake_gpio.P[port].DOUT &= ~(1u << pin);
+  fake_gpio_sync();
+}
+
+void I2C_Init(I2C_TypeDef *i2c, const I2C_Init_TypeDef *init) {
+  FAKE_BUS_STRUCT *bus = &buses[i2c == &fake_i2c1];
+  i2c->CTRL = init->enable ? I2C_CTRL_EN : 0;
+  bus->bit_ns = NS_PER_S / init->freq;
+}
+
+void LDMA_Init(const LDMA_Init_t *init) {
+  NVIC_EnableIRQ(LDMA_IRQn);
+}
+
+void LDMA_StartTransfer(int ch, const LDMA_TransferCfg_t *transfer, const LDMA_Descriptor_t *descriptor) {
+  ldma_channels[ch].signal = transfer->ldmaReqSel;
+  fake_ldma_load(ch, descriptor);
+  fake_hw_sync();
+}
+
+void LDMA_StopTransfer(int ch) { ldma_channels[ch].active = false; }
+bool LDMA_TransferDone(int ch) { return !ldma_channels[ch].active; }
+uint32_t LDMA_IntGet(void) { return ldma_if; }
+uint32_t LDMA_IntGetEnabled(void) { return ldma_if; }
+void LDMA_IntClear(uint32_t flags) { ldma_if &= ~flags; }
+
+void LETIMER_Init(LETIMER_TypeDef *letimer, const LETIMER_Init_TypeDef *init) {
+  if (init->enable) {
+      letimer->CMD = LETIMER_CMD_START;
+  }
+  fake_letimer_sync();
+}
+
+void LEUART_Init(LEUART_TypeDef *leuart, const LEUART_Init_TypeDef *init) {
+  leuart_bit_ns = NS_PER_S / init->baudrate;
+}
+
+void MSC_Init(void) { }
+void MSC_Deinit(void) { }
+
+MSC_Status_TypeDef MSC_ErasePage(uint32_t *startAddress) {
+  uintptr_t offset = (uintptr_t)startAddress - FLASH_BASE;
+  if (offset >= FLASH_SIZE || offset % FLASH_PAGE_SIZE) {
+      return mscReturnInvalidAddr;
+  }
+  memset(&fake_flash[offset], 0xFF, FLASH_PAGE_SIZE);
+  return mscReturnOk;
+}
+
+MSC_Status_TypeDef MSC_WriteWord(uint32_t *address, void const *data, uint32_t numBytes) {
+  uintptr_t offset = (uintptr_t)address - FLASH_BASE;
+  if (offset % 4 || numBytes % 4 || offset + numBytes > FLASH_SIZE) {
+      return mscReturnInvalidAddr;
+  }
+  for (uint32_t i = 0; i < numBytes; i++) {
+      fake_flash[offset + i] &= ((const uint8_t *)data)[i]; // Programming only clears bits
+  }
+  return mscReturnOk;
+}
+
+void TIMER_Init(TIMER_TypeDef *timer, const TIMER_Init_TypeDef *init) {
+  FAKE_TIMER_STRUCT *fake = &timers[timer == &fake_wtimer1];
+  if (init->mode != timerModeUp || init->oneShot) {
+      fake_fatal("only free running up counts are modelled");
+  }
+  fake->running = init->enable;
+  fake->prescale = init->prescale;
+  fake->base_ns = fake_hf_ns();
+  timer->CNT = 0;
+}
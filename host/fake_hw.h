@@ -0,0 +1,58 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef FAKE_HW_HG
+#define FAKE_HW_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Silicon Labs include statements */
+#include "em_device.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+// The peripherals of em_device.h are plain structs. Writes land in them like
+// any other memory and take effect at the next fake_hw_sync(), which the fake
+// emlib calls from EFM_ASSERT, the critical sections, I2C_IntGet and the
+// sleep calls. Code between two syncs runs in no simulated time.
+
+#define FAKE_I2C_MAX_DEVICES  2   // Slaves per bus
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// A slave on a fake I2C bus, called as each part of a transfer completes
+typedef struct {
+  uint8_t address; // 7-bit address
+  bool (*start)(void *ctx, bool read); // Address matched, returns the ACK
+  bool (*write)(void *ctx, uint8_t byte); // Byte written, returns the ACK
+  uint8_t (*read)(void *ctx); // Next byte read
+  void (*stop)(void *ctx); // Stop or abort ends the transfer
+  void *ctx;
+} FAKE_I2C_DEVICE_STRUCT;
+
+typedef struct {
+  uint64_t residency_ns[4]; // Simulated time spent in EM0 to EM3
+  uint32_t wakes; // Sleeps ended by an interrupt
+} FAKE_EMU_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void fake_hw_open(void);
+void fake_hw_sync(void);
+void fake_hw_assert_failed(const char *file, int line, const char *expr) __attribute__((noreturn));
+uint64_t fake_hw_now(void);
+
+uint32_t fake_core_enter(void);
+void fake_core_exit(uint32_t state);
+
+void fake_i2c_attach(I2C_TypeDef *i2c, const FAKE_I2C_DEVICE_STRUCT *device);
+bool fake_gpio_pin(unsigned int port, unsigned int pin, uint64_t *since);
+void fake_emu_get(FAKE_EMU_STRUCT *emu);
+uint32_t fake_leuart_bytes(void);
+
+#endif
@@ -0,0 +1,285 @@
+/*****************************************************
+ * @file sensor_models.c
+ * @author Branson Camp
+ * @date 12/16/2022
+ * @brief I2C slave models of the SI7021 and SHTC3
+ * that convert scripted readings.
+ *
+ ****************************************************/
+
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+/* System include statements */
+#include <string.h>
+
+/* The developer's include statements */
+#include "sensor_models.h"
+#include "brd_config.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SI7021_MODEL_ADDRESS    0x40
+#define SHTC3_MODEL_ADDRESS     0x70
+#define MODEL_CRC_POLY          0x31  // x^8 + x^5 + x^4 + 1, both sensors
+
+//***********************************************************************************
+// Private variables
+//***********************************************************************************
+// SI7021 RH plus temperature conversion time by resolution bits, datasheet maximums
+static const uint64_t si7021_conversion_ns[4] = {
+  22800000ull, // RH 12 bit, T 14 bit
+  6900000ull,  // RH 8 bit, T 12 bit
+  10700000ull, // RH 10 bit, T 13 bit
+  9400000ull,  // RH 11 bit, T 11 bit
+};
+
+//***********************************************************************************
+// Private functions
+//***********************************************************************************
+static uint8_t model_crc(const uint8_t *data, uint32_t len, uint8_t init) {
+  uint8_t crc = init;
+  for (uint32_t i = 0; i < len; i++) {
+      crc ^= data[i];
+      for (int bit = 0; bit < 8; bit++) {
+          crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ MODEL_CRC_POLY) : (uint8_t)(crc << 1);
+      }
+  }
+  return crc;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Converts a value to a sensor code, code = (value - offset) * 65536 / gain.
+ ******************************************************************************/
+static uint16_t model_code(int32_t value, int32_t offset, int32_t gain) {
+  int64_t code = ((int64_t)(value - offset) * 65536 + gain - 1) / gain;
+  if (code < 0) {
+      code = 0;
+  } else if (code > 0xFFFF) {
+      code = 0xFFFF;
+  }
+  return (uint16_t)code;
+}
+
+static void model_put_word(SENSOR_MODEL_STRUCT *model, uint16_t code, bool crc, uint8_t crc_init) {
+  uint8_t *out = &model->out[model->out_len];
+  out[0] = code >> 8;
+  out[1] = code & 0xFF;
+  model->out_len += 2;
+  if (crc) {
+      out[2] = model_crc(out, 2, crc_init);
+      model->out_len++;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Starts a conversion of the next script sample.
+ ******************************************************************************/
+static void model_convert(SENSOR_MODEL_STRUCT *model, uint64_t duration) {
+  model->sample = model->script[model->next];
+  model->next = (model->next + 1) % model->script_len;
+  model->conversions++;
+  model->converting = true;
+  model->busy_until = fake_hw_now() + duration;
+  model->out_len = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Checks the power of a sensor, both share the SI7021 enable pin.
+ *
+ * @details
+ *   A sensor powered up again since it was last used starts from its reset
+ *   state.
+ *
+ * @return
+ *   Whether the sensor is powered and past its startup time.
+ ******************************************************************************/
+static bool model_ready(SENSOR_MODEL_STRUCT *model, uint64_t startup_ns) {
+  uint64_t since;
+  if (!fake_gpio_pin(SI7021_SENSOR_EN_PORT, SI7021_SENSOR_EN_PIN, &since)) {
+      return false;
+  }
+  if (since != model->powered_since) {
+      model->powered_since = since;
+      model->asleep = false;
+      model->converting = false;
+      model->busy_until = 0;
+      model->command_bytes = 0;
+      model->out_len = 0;
+      model->user = SI7021_MODEL_USER_RESET;
+  }
+  return fake_hw_now() - since >= startup_ns;
+}
+
+static bool model_busy(const SENSOR_MODEL_STRUCT *model) {
+  return fake_hw_now() < model->busy_until;
+}
+
+static uint8_t model_read(void *ctx) {
+  SENSOR_MODEL_STRUCT *model = ctx;
+  return model->out_pos < model->out_len ? model->out[model->out_pos++] : 0xFF;
+}
+
+static void model_stop(void *ctx) {
+  SENSOR_MODEL_STRUCT *model = ctx;
+  model->command_bytes = 0;
+}
+
+/***************************************************************************//**
+ * @brief
+ *   SI7021 address phase. Every header is NACKed during a conversion.
+ ******************************************************************************/
+static bool si7021_model_start(void *ctx, bool read) {
+  SENSOR_MODEL_STRUCT *model = ctx;
+  if (!model_ready(model, SI7021_MODEL_STARTUP_NS) || model_busy(model)) {
+      return false;
+  }
+  model->command_bytes = 0;
+  if (!read) {
+      return true;
+  }
+
+  if (model->converting) {
+      // RH no hold master, the temperature is kept for 0xE0
+      model->converting = false;
+      model->out_len = 0;
+      model_put_word(model, model_code(model->sample.humidity, -600, 12500) & ~3, true, 0x00);
+  }
+  model->out_pos = 0;
+  return model->out_len > 0;
+}
+
+static bool si7021_model_write(void *ctx, uint8_t byte) {
+  SENSOR_MODEL_STRUCT *model = ctx;
+  if (model->command_bytes == 1 && model->command == 0xE6) {
+      model->user = byte; // Write user register
+      model->command_bytes++;
+      return true;
+  }
+  if (model->command_bytes > 0) {
+      return false;
+  }
+
+  model->command = byte;
+  model->command_bytes = 1;
+  model->out_len = 0;
+  switch (byte) {
+    case 0xF5: // Measure RH, no hold master
+      model_convert(model, si7021_conversion_ns[((model->user >> 6) & 0x2) | (model->user & 0x1)]);
+      return true;
+    case 0xE0: // Temperature of the last RH conversion
+      model_put_word(model, model_code(model->sample.temp, -4685, 17572) & ~3, false, 0);
+      return true;
+    case 0xE7: // Read user register
+      model->out[0] = model->user;
+      model->out_len = 1;
+      return true;
+    case 0xE6:
+      return true;
+    default:
+      return false;
+  }
+}
+
+/***************************************************************************//**
+ * @brief
+ *   SHTC3 address phase. Headers are NACKed while it measures, asleep only
+ *   the wakeup command is taken.
+ ******************************************************************************/
+static bool shtc3_model_start(void *ctx, bool read) {
+  SENSOR_MODEL_STRUCT *model = ctx;
+  if (!model_ready(model, SHTC3_MODEL_STARTUP_NS) || model_busy(model)) {
+      return false;
+  }
+  model->command_bytes = 0;
+  if (!read) {
+      return true;
+  }
+  if (model->asleep || !model->converting) {
+      return false;
+  }
+
+  // Temperature first
+  model->converting = false;
+  model->out_len = 0;
+  model_put_word(model, model_code(model->sample.temp, -4500, 17500), true, 0xFF);
+  model_put_word(model, model_code(model->sample.humidity, 0, 10000), true, 0xFF);
+  model->out_pos = 0;
+  return true;
+}
+
+static bool shtc3_model_write(void *ctx, uint8_t byte) {
+  SENSOR_MODEL_STRUCT *model = ctx;
+  if (model->command_bytes >= 2) {
+      return false;
+  }
+  model->command = (model->command_bytes ? model->command << 8 : 0) | byte;
+  model->command_bytes++;
+  if (model->asleep && (model->command_bytes == 1 ? byte != 0x35 : model->command != 0x3517)) {
+      return false;
+  }
+  if (model->command_bytes < 2) {
+      return true;
+  }
+
+  switch (model->command) {
+    case 0x3517: // Wakeup
+      model->asleep = false;
+      model->busy_until = fake_hw_now() + SHTC3_MODEL_STARTUP_NS;
+      return true;
+    case 0xB098: // Sleep
+      model->asleep = true;
+      model->converting = false;
+      return true;
+    case 0x7866: // Normal mode, T first, the clock stretching variants are polled alike
+    case 0x7CA2:
+      model_convert(model, SHTC3_MODEL_NORMAL_NS);
+      return true;
+    case 0x609C: // Low power mode, T first
+    case 0x6458:
+      model_convert(model, SHTC3_MODEL_LP_NS);
+      return true;
+    default:
+      return false;
+  }
+}
+
+//***********************************************************************************
+// Global functions
+//***********************************************************************************
+
+/***************************************************************************//**
+ * @brief
+ *   Puts an SI7021 model on I2C0.
+ *
+ * @param[in] script
+ *  Readings returned by the conversions, played in a loop
+ ******************************************************************************/
+void si7021_model_open(SENSOR_MODEL_STRUCT *model, const SENSOR_MODEL_SAMPLE_STRUCT *script, uint32_t script_len) {
+  memset(model, 0, sizeof(*model));
+  model->script = script;
+  model->script_len = script_len;
+  model->powered_since = UINT64_MAX;
+  model->device = (FAKE_I2C_DEVICE_STRUCT){ SI7021_MODEL_ADDRESS, si7021_model_start, si7021_model_write, model_read, model_stop, model };
+  fake_i2c_attach(I2C0, &model->device);
+}
+
+/***************************************************************************//**
+ * @brief
+ *   Puts an SHTC3 model on I2C1.
+ *
+ * @param[in] script
+ *  Readings returned by the conversions, played in a loop
+ ******************************************************************************/
+void shtc3_model_open(SENSOR_MODEL_STRUCT *model, const SENSOR_MODEL_SAMPLE_STRUCT *script, uint32_t script_len) {
+  memset(model, 0, sizeof(*model));
+  model->script = script;
+  model->script_len = script_len;
+  model->powered_since = UINT64_MAX;
+  model->device = (FAKE_I2C_DEVICE_STRUCT){ SHTC3_MODEL_ADDRESS, shtc3_model_start, shtc3_model_write, model_read, model_stop, model };
+  fake_i2c_attach(I2C1, &model->device);
+}
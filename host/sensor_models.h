@@ -0,0 +1,59 @@
+//***********************************************************************************
+// Include files
+//***********************************************************************************
+#ifndef SENSOR_MODELS_HG
+#define SENSOR_MODELS_HG
+
+/* System include statements */
+#include <stdint.h>
+#include <stdbool.h>
+
+/* The developer's include statements */
+#include "fake_hw.h"
+
+//***********************************************************************************
+// defined files
+//***********************************************************************************
+#define SI7021_MODEL_STARTUP_NS   80000000ull // Datasheet maximum powerup time
+#define SI7021_MODEL_USER_RESET   0x3A        // User register after power on
+#define SHTC3_MODEL_STARTUP_NS    240000ull   // Datasheet maximum powerup and wakeup time
+#define SHTC3_MODEL_NORMAL_NS     12100000ull // Normal mode measurement, datasheet maximum
+#define SHTC3_MODEL_LP_NS         800000ull   // Low power mode measurement, datasheet maximum
+
+//***********************************************************************************
+// global variables
+//***********************************************************************************
+// One conversion of a script, in the firmware's units
+typedef struct {
+  int32_t temp; // centi-degC
+  int32_t humidity; // centi-%RH
+} SENSOR_MODEL_SAMPLE_STRUCT;
+
+typedef struct {
+  const SENSOR_MODEL_SAMPLE_STRUCT *script; // Played in order, then from the start again
+  uint32_t script_len;
+  uint32_t next; // Sample of the next conversion
+  uint32_t conversions;
+
+  uint64_t powered_since; // Power on time the state belongs to
+  bool asleep; // SHTC3 sleep command
+  uint32_t command; // Command bytes of the current write
+  uint32_t command_bytes;
+  bool converting; // A result waits to be read
+  uint64_t busy_until; // Headers are NACKed until then
+  SENSOR_MODEL_SAMPLE_STRUCT sample; // Of the last conversion
+  uint8_t user; // SI7021 user register
+  uint8_t out[6]; // Bytes the next read returns
+  uint32_t out_len;
+  uint32_t out_pos;
+
+  FAKE_I2C_DEVICE_STRUCT device;
+} SENSOR_MODEL_STRUCT;
+
+//***********************************************************************************
+// function prototypes
+//***********************************************************************************
+void si7021_model_open(SENSOR_MODEL_STRUCT *model, const SENSOR_MODEL_SAMPLE_STRUCT *script, uint32_t script_len);
+void shtc3_model_open(SENSOR_MODEL_STRUCT *model, const SENSOR_MODEL_SAMPLE_STRUCT *script, uint32_t script_len);
+
+#endif
@@ -51,52 +51,7 @@ int main(void)
     if (!get_scheduled_events()) enter_sleep();
     CORE_EXIT_CRITICAL();
 
-    if (get_scheduled_events() & LETIMER0_UF_CB) {
-        remove_scheduled_event(LETIMER0_UF_CB);
-        scheduled_letimer0_uf_cb();
-    }
-
-    if (get_scheduled_events() & LETIMER0_COMP0_CB) {
-        EFM_ASSERT(false); // This interrupt should never happen
-        remove_scheduled_event(LETIMER0_COMP0_CB);
-        scheduled_letimer0_comp0_cb();
-    }
-
-    if (get_scheduled_events() & LETIMER0_COMP1_CB) {
-        remove_scheduled_event(LETIMER0_COMP1_CB);
-        scheduled_letimer0_comp1_cb();
-    }
-
-    // Buttons are not used for lab 5, callbacks are commented out
-    if (get_scheduled_events() & GPIO_ODD_IRQ_CB) {
-        remove_scheduled_event(GPIO_ODD_IRQ_CB);
-        //scheduled_gpio_odd_irq_cb();
-    }
-
-    if (get_scheduled_events() & GPIO_EVEN_IRQ_CB) {
-        remove_scheduled_event(GPIO_EVEN_IRQ_CB);
-        //scheduled_gpio_even_irq_cb();
-    }
-
-    if (get_scheduled_events() & SI7021_READ_HUM_CB) {
-        remove_scheduled_event(SI7021_READ_HUM_CB);
-        scheduled_si7021_read_hum_cb();
-    }
-
-    if (get_scheduled_events() & SI7021_READ_TEMP_CB) {
-        remove_scheduled_event(SI7021_READ_TEMP_CB);
-        scheduled_si7021_read_temp_cb();
-    }
-
-    if (get_scheduled_events() & SHTC3_READ_CB) {
-      remove_scheduled_event(SHTC3_READ_CB);
-      scheduled_shtc3_read_irq_cb();
-    }
-
-    if (get_scheduled_events() & SI7021_USER_CONFIRM) {
-        remove_scheduled_event(SI7021_USER_CONFIRM);
-        scheduled_si7021_user_confirm();
-    }
+    scheduler_dispatch();
   }
 }
 